@@ -24,6 +24,7 @@
 #include "Buffer.hh"
 #include "Texture.hh"
 #include "Program.hh"
+#include "RenderQueue.hh"
 
 namespace neat {
 
@@ -36,6 +37,8 @@ class Billboard : private NoCopy {
     explicit Billboard(const glm::vec4& rect) noexcept;
     Billboard(Billboard&& rhs) noexcept;
     void render(const Texture& texture) const noexcept;
+    /** records the billboard into 'list', without GL calls */
+    void render(RenderQueue::List& list, const Texture& texture) const noexcept;
 
     static void draw(const glm::vec4& rect, const Texture& texture);
 };
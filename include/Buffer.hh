@@ -24,7 +24,13 @@ namespace neat {
 
 class Buffer : private GLResource {
   public:
-    enum class Target : unsigned { Array = 0x8892, ElementArray = 0x8893 };
+    enum class Target : unsigned {
+        Array = 0x8892,
+        ElementArray = 0x8893,
+        DrawIndirect = 0x8F3F,
+        ShaderStorage = 0x90D2,
+        Uniform = 0x8A11
+    };
     explicit Buffer(
         Target target = Target::Array, bool dynamic = false) noexcept;
     Buffer(Buffer&& rhs) noexcept;
@@ -32,8 +38,18 @@ class Buffer : private GLResource {
     Buffer& operator=(Buffer&& rhs) noexcept;
     void bind() const noexcept;
     void unbind() const noexcept;
+    /** binds the buffer to 'index' of an indexed target */
+    void bindBase(Target target, unsigned index) const noexcept;
+    /** binds 'size' bytes from 'offset' on to 'index' of an indexed
+        target */
+    void bindRange(Target target, unsigned index, std::size_t offset,
+        std::size_t size) const noexcept;
     void set(const void* data, std::size_t size) const noexcept;
+    /** replaces 'size' bytes from 'offset' on, keeping the storage */
+    void update(
+        std::size_t offset, const void* data, std::size_t size) const noexcept;
     [[nodiscard]] unsigned size() const noexcept;
+    [[nodiscard]] unsigned int getRawId() const noexcept;
 
     template <typename _Tp>
     void set(const std::vector<_Tp>& data) const noexcept {
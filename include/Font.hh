@@ -39,6 +39,8 @@ class Font : private NoCopy {
     [[nodiscard]] bool valid() const noexcept;
     void bind() const noexcept;
     void unbind() const noexcept;
+    /** GL name of the glyph atlas texture */
+    [[nodiscard]] unsigned int getRawTextureId() const noexcept;
     [[nodiscard]] std::vector<glm::vec4> calculate(
         std::string_view, float x, float y) const noexcept;
     ~Font();
@@ -0,0 +1,117 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include "Jobs.hh"
+#include "NoCopy.hh"
+
+namespace neat {
+
+/** Overlaps the simulation of frame N + 1 with the rendering of frame N,
+    and keeps the render thread to GL work. Simulation writes everything
+    rendering needs to a snapshot; snapshots are double buffered so each
+    stage owns one. Every frame() on the render thread:
+    - render(snapshot) submits what the last record stage prepared, while
+      the GL state is still the one apply set up for it,
+    - waits for the simulation started by the previous call,
+    - apply(snapshot) updates what the other stages read, such as
+      Model::setPos, while no job runs,
+    - starts record(snapshot) on a worker, for the next render, and
+      simulate(time, other snapshot) on another one.
+    The first frames render the first snapshot, recorded on the render
+    thread, until the pipeline fills; every time is simulated once */
+template <class Snapshot>
+class FramePipeline : private NoCopy {
+  public:
+    using Simulate = std::function<void(uint64_t time, Snapshot& snapshot)>;
+    using Stage = std::function<void(const Snapshot& snapshot)>;
+
+  private:
+    Simulate simulate_;
+    Stage apply_;
+    Stage record_;
+    Stage render_;
+    Jobs& jobs_;
+    std::array<Snapshot, 2> snapshots_{};
+    unsigned current_ = 0;
+    bool started_ = false;
+    bool simulating_ = false;
+    bool recording_ = false;
+    Job simulationJob_;
+    Job recordingJob_;
+
+  public:
+    /** 'jobs' has to outlive the pipeline */
+    FramePipeline(Simulate simulate, Stage apply, Stage record,
+        Stage render, Jobs& jobs = Jobs::instance()) :
+        simulate_(std::move(simulate)),
+        apply_(std::move(apply)),
+        record_(std::move(record)),
+        render_(std::move(render)),
+        jobs_(jobs) {
+    }
+
+    ~FramePipeline() noexcept {
+        jobs_.wait(recordingJob_);
+        jobs_.wait(simulationJob_);
+    }
+
+    void frame(uint64_t time) {
+        auto simulated = !started_;
+        if (simulated) {
+            // nothing to render yet, the first frame simulates in place
+            simulate_(time, snapshots_[current_]);
+            apply_(snapshots_[current_]);
+            started_ = true;
+        }
+
+        const auto& shown = snapshots_[current_];
+        if (recording_) {
+            jobs_.wait(recordingJob_);
+            recording_ = false;
+        } else {
+            record_(shown);
+        }
+        render_(shown);
+
+        if (simulating_) {
+            jobs_.wait(simulationJob_);
+            simulating_ = false;
+            current_ ^= 1;
+            apply_(snapshots_[current_]);
+            recordingJob_ = jobs_.submit(
+                [this, &snapshot = snapshots_[current_]] {
+                    record_(snapshot);
+                });
+            recording_ = true;
+        }
+        if (!simulated) {
+            simulationJob_ = jobs_.submit(
+                [this, time, &snapshot = snapshots_[current_ ^ 1]] {
+                    simulate_(time, snapshot);
+                });
+            simulating_ = true;
+        }
+        jobs_.runMain();
+    }
+};
+
+}  // namespace neat
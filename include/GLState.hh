@@ -0,0 +1,101 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "NoCopy.hh"
+
+namespace neat {
+
+/** Shadow of the GL state neat binds, for the context of the render
+    thread: calls that would not change it are skipped. Code changing this
+    state with GL directly calls invalidate() afterwards */
+class GLState : private NoCopy {
+    static constexpr unsigned Unknown = ~0u;
+    static constexpr unsigned Units = 16;
+    static constexpr unsigned Blocks = 8;
+
+    enum Target : unsigned {
+        Array,
+        ElementArray,
+        DrawIndirect,
+        ShaderStorage,
+        Uniform,
+        Targets
+    };
+
+    enum Cap : unsigned { Blend, DepthTest, CullFace, Caps };
+
+  public:
+    struct Stats {
+        unsigned issued = 0;  // GL calls made
+        unsigned elided = 0;  // GL calls skipped as already current
+    };
+
+  private:
+    /** buffer range bound to a uniform block binding point */
+    struct Range {
+        unsigned buffer;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    unsigned program_ = Unknown;
+    unsigned vertexArray_ = Unknown;
+    unsigned unit_ = Unknown;
+    std::array<unsigned, Targets> buffers_{};
+    std::array<unsigned, Units> textures_{};
+    std::array<unsigned, Caps> caps_{};
+    std::array<Range, Blocks> blocks_{};
+    Stats stats_;
+
+    GLState() noexcept;
+    bool change(unsigned& current, unsigned value) noexcept;
+
+  public:
+    static GLState& instance() noexcept;
+
+    void useProgram(unsigned program) noexcept;
+    void bindVertexArray(unsigned vertexArray) noexcept;
+    void bindBuffer(unsigned target, unsigned buffer) noexcept;
+    /** binds to 'index' of an indexed target, which binds 'target' too */
+    void bindBufferBase(
+        unsigned target, unsigned index, unsigned buffer) noexcept;
+    /** binds 'size' bytes from 'offset' on to 'index' of an indexed target,
+        skipped when that uniform block binding already holds them */
+    void bindBufferRange(unsigned target, unsigned index, unsigned buffer,
+        std::size_t offset, std::size_t size) noexcept;
+    /** binds a 2D texture to texture unit 'unit' */
+    void bindTexture(unsigned unit, unsigned texture) noexcept;
+    /** glEnable or glDisable of GL_BLEND, GL_DEPTH_TEST or GL_CULL_FACE */
+    void enable(unsigned cap, bool enabled) noexcept;
+    [[nodiscard]] bool enabled(unsigned cap) noexcept;
+
+    /** deleting an object unbinds it, its name may come back later */
+    void deleteBuffer(unsigned buffer) noexcept;
+    void deleteTexture(unsigned texture) noexcept;
+    void deleteVertexArray(unsigned vertexArray) noexcept;
+
+    /** forgets everything, the next calls are all issued */
+    void invalidate() noexcept;
+    /** counters since the previous call, once per frame */
+    Stats stats() noexcept;
+};
+
+}  // namespace neat
@@ -0,0 +1,68 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "Model.hh"
+#include "NoCopy.hh"
+#include "PImpl.hh"
+
+namespace neat {
+
+struct HLodOptions {
+    /** edge of the grid cells static instances are clustered by */
+    float cellSize = 64.f;
+    /** clusters whose bounds are farther than this from the eye draw
+        their proxy instead of the models */
+    float distance = 256.f;
+    /** proxy simplification error relative to the cell size */
+    float error = 0.02f;
+    /** atlas resolution of every baked material */
+    unsigned tileSize = 64;
+};
+
+/** Hierarchical LOD: merges clusters of static instances into simplified
+    proxies sharing one baked texture atlas */
+class HLod : private NoCopy {
+    class Impl;
+
+    PImpl<Impl, 280, 8> pImpl_;
+
+  public:
+    explicit HLod(const HLodOptions& options = {}) noexcept;
+    HLod(HLod&& rhs) noexcept;
+    ~HLod() noexcept;
+
+    /** registers static instances of a model, must precede build() */
+    void add(std::string_view filename,
+        const std::vector<glm::mat4>& instances,
+        const ModelOptions& options = {}) noexcept;
+    /** clusters the instances, builds the proxies and bakes the atlas */
+    void build() noexcept;
+    /** draws near clusters as models and far ones as proxies, using the
+        camera passed to Model::setVP */
+    void render() const noexcept;
+
+    /** number of proxies drawn by the last render */
+    [[nodiscard]] unsigned proxies() const noexcept;
+};
+
+}  // namespace neat
@@ -0,0 +1,50 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "GLResource.hh"
+
+namespace neat {
+
+/** Depth target and its max-depth mip pyramid used by GPU occlusion
+    culling. Draw the occluders between begin() and end() */
+class HiZ : private GLResource {
+    unsigned depth_ = 0;
+    unsigned pyramid_ = 0;
+    unsigned width_;
+    unsigned height_;
+    unsigned levels_ = 1;
+    int framebuffer_ = 0;
+    int viewport_[4] = {};
+
+  public:
+    HiZ(unsigned width, unsigned height) noexcept;
+    HiZ(HiZ&& rhs) noexcept;
+    ~HiZ();
+
+    /** redirects rendering to the depth target and clears it */
+    void begin() noexcept;
+    /** restores the previous framebuffer and rebuilds the pyramid */
+    void end() const noexcept;
+
+    [[nodiscard]] unsigned int getRawId() const noexcept;
+    [[nodiscard]] unsigned width() const noexcept;
+    [[nodiscard]] unsigned height() const noexcept;
+    [[nodiscard]] unsigned levels() const noexcept;
+};
+
+}  // namespace neat
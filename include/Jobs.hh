@@ -0,0 +1,80 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "NoCopy.hh"
+#include "PImpl.hh"
+
+namespace neat {
+
+struct JobState;
+
+/** Submitted job, to wait for or to run other jobs after */
+class Job {
+    friend class Jobs;
+    std::shared_ptr<JobState> state_;
+
+  public:
+    Job() noexcept = default;
+    /** true for default constructed jobs */
+    [[nodiscard]] bool done() const noexcept;
+};
+
+/** Work stealing scheduler: every worker owns a deque it pops from the
+    back, idle workers steal from the front of the others. Jobs can wait
+    for other jobs and can be bound to the main thread, where GL calls are
+    allowed; those run in runMain() or while the main thread waits */
+class Jobs : private NoCopy {
+    class Impl;
+
+    PImpl<Impl, 280, 8> pImpl_;
+
+  public:
+    enum class Affinity { Any, Main };
+
+    /** 'workers' threads besides the calling one, which becomes the main
+        thread; 0 picks one less than the hardware threads */
+    explicit Jobs(unsigned workers = 0);
+    ~Jobs() noexcept;
+
+    /** scheduler shared by the library and applications, created on first
+        use by the thread that will run main thread jobs */
+    static Jobs& instance();
+
+    /** runs 'task' once all of 'after' are done */
+    Job submit(std::function<void()> task, const std::vector<Job>& after = {},
+        Affinity affinity = Affinity::Any);
+    /** runs other jobs until 'job' is done */
+    void wait(const Job& job) noexcept;
+    /** runs the main thread jobs queued so far, call once per frame */
+    void runMain() noexcept;
+
+    /** splits [0, count) into chunks of at least 'grain' items, calls
+        func(begin, end) for each of them in parallel and returns when all
+        are done */
+    void parallelFor(std::size_t count, std::size_t grain,
+        const std::function<void(std::size_t, std::size_t)>& func);
+
+    [[nodiscard]] unsigned workers() const noexcept;
+};
+
+}  // namespace neat
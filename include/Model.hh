@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <optional>
 #include <string_view>
 #include <vector>
 
@@ -23,30 +24,123 @@
 
 #include "NoCopy.hh"
 #include "PImpl.hh"
+#include "RenderQueue.hh"
 
 namespace neat {
 
+enum class VertexFormat {
+    Float,      // 32 bytes per vertex, full precision
+    Half,       // 16 bytes per vertex, half float positions
+    Normalized  // 16 bytes per vertex, 16-bit positions relative to AABB
+};
+
+struct ModelOptions {
+    VertexFormat format = VertexFormat::Float;
+    /** reorder and weld vertices for the post-transform cache at load */
+    bool optimize = false;
+    std::string_view cacheDirectory;
+    /** simplification error of every generated LOD, relative to the model
+        radius; instances use the coarsest LOD whose projected error stays
+        below lodScreenError (in normalized device units) */
+    std::vector<float> lodErrors;
+    float lodScreenError = 0.002f;
+    /** skip instances outside the view frustum passed to setVP */
+    bool cull = false;
+    /** cull and pick LODs in a compute shader (GLES 3.1) feeding indirect
+        draws, with occlusion against setHiZ() when set */
+    bool gpuCulling = false;
+    /** skip the model while a hardware occlusion query of its bounding
+        box reports it hidden; draw large occluders first */
+    bool occlusionQuery = false;
+    /** keep geometry on the CPU for renderOccluder, which draws the
+        coarsest LOD */
+    bool occluder = false;
+    /** split meshes into clusters of triangles, each skipped when out of
+        the frustum or facing away; for large closed meshes drawn with few
+        instances, as every visible instance is drawn on its own */
+    bool meshlets = false;
+    /** keep geometry on the CPU and a triangle hierarchy of the full
+        detail mesh for intersect */
+    bool pickable = false;
+    /** keep positions and indices on the CPU, shared by every model of the
+        same file and processing; implied by occluder and pickable */
+    bool retainGeometry = false;
+    /** store retained positions as 16-bit values within the bounds */
+    bool quantizeGeometry = false;
+};
+
+struct RenderStats {
+    unsigned draws = 0;     // renders that drew the model
+    unsigned culled = 0;    // renders skipped by occlusion queries
+    unsigned queries = 0;   // occlusion queries issued
+    unsigned occluded = 0;  // instances hidden by the occlusion buffer
+    unsigned meshlets = 0;  // meshlets skipped by cluster culling
+};
+
+struct ModelData;
+class HiZ;
+class OcclusionBuffer;
+struct Box;
+
 class Model : private NoCopy {
     class Impl;
 
-    PImpl<Impl, 128, 8> pImpl_;
+    PImpl<Impl, 648, 8> pImpl_;
+
+    friend class HLod;
+    Model(ModelData&& data, const ModelOptions& options) noexcept;
 
   public:
-    explicit Model(std::string_view filename) noexcept;
+    explicit Model(
+        std::string_view filename, const ModelOptions& options = {}) noexcept;
     Model(Model&& rhs) noexcept;
     ~Model() noexcept;
 
     void setPos(const glm::mat4& pos) const noexcept;
     void setPos(const std::vector<glm::mat4>& pos) const noexcept;
+    /** instances at parent * local[i], multiplied with the batch kernels
+        of Transform.hh */
+    void setPos(const glm::mat4& parent,
+        const std::vector<glm::mat4>& local) const noexcept;
     void render(unsigned instances = 1) const noexcept;
+    /** records the draws into 'list' instead, as often per submit as
+        needed; makes no GL call, so workers may record different models
+        in parallel, but one model only on one thread at a time as its
+        culling scratch is shared. Models using gpuCulling or
+        occlusionQuery record on the render thread */
+    void render(RenderQueue::List& list, unsigned instances = 1) const noexcept;
 
     [[nodiscard]] bool valid() const noexcept;
+    /** number of instances drawn by the last render */
+    [[nodiscard]] unsigned visible() const noexcept;
+    /** world space box of an instance */
+    [[nodiscard]] Box bounds(unsigned instance = 0) const noexcept;
+    /** distance along a world space ray to the surface of an instance, in
+        units of 'direction'; needs options.pickable */
+    [[nodiscard]] std::optional<float> intersect(const glm::vec3& origin,
+        const glm::vec3& direction, unsigned instance = 0) const noexcept;
+    /** rasterizes every instance into 'buffer', needs options.occluder */
+    void renderOccluder(OcclusionBuffer& buffer) const noexcept;
 
     static void setLight(unsigned index, const glm::vec3& position,
         const glm::vec3& color, float attenuation) noexcept;
     static void setSun(
         const glm::vec3& direction, const glm::vec3& color) noexcept;
     static void setVP(const glm::mat4& v, const glm::mat4& p) noexcept;
+    /** waits for the shaders setSun and setLight build in the background,
+        before RenderQueue::prewarm while loading */
+    static void finishShaders() noexcept;
+    /** lets recordings use the shaders built in the background once they
+        are ready, setVP polls too; call once per frame on the render
+        thread while no worker records */
+    static void pollShaders() noexcept;
+    /** depth pyramid for GPU occlusion culling, nullptr disables it */
+    static void setHiZ(const HiZ* hiZ) noexcept;
+    /** CPU depth buffer instances are tested against after frustum
+        culling, nullptr disables it */
+    static void setOcclusion(const OcclusionBuffer* buffer) noexcept;
+    /** counters of all models since the previous call, once per frame */
+    static RenderStats stats() noexcept;
 };
 
 }  // namespace neat
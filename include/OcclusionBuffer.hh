@@ -0,0 +1,75 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "NoCopy.hh"
+
+namespace neat {
+
+/** Coarse CPU depth buffer filled with occluder triangles, against which
+    boxes are tested before any GL work. Rasterization runs in parallel
+    over screen tiles. Each frame: begin(), add() the occluders, end(),
+    then query visible() */
+class OcclusionBuffer : private NoCopy {
+  public:
+    static constexpr unsigned tileSize = 32;
+    static constexpr unsigned blockSize = 8;
+
+    explicit OcclusionBuffer(
+        unsigned width = 256, unsigned height = 128) noexcept;
+
+    void begin(const glm::mat4& vp) noexcept;
+    void add(const std::vector<glm::vec3>& vertices,
+        const std::vector<uint32_t>& indices,
+        const glm::mat4& transform) noexcept;
+    void end() noexcept;
+
+    /** whether the box given in the space of 'transform' may be seen */
+    [[nodiscard]] bool visible(const glm::vec3& min, const glm::vec3& max,
+        const glm::mat4& transform) const noexcept;
+
+    [[nodiscard]] unsigned width() const noexcept;
+    [[nodiscard]] unsigned height() const noexcept;
+    /** depth in [0, 1] per pixel, rows from the bottom */
+    [[nodiscard]] const std::vector<float>& depth() const noexcept;
+
+  private:
+    struct Triangle {
+        glm::vec3 v[3];  // pixel x, pixel y, depth
+    };
+
+    unsigned width_;
+    unsigned height_;
+    unsigned tilesX_;
+    unsigned tilesY_;
+    glm::mat4 vp_{1.f};
+    std::vector<float> depth_;
+    std::vector<float> blockMax_;
+    std::vector<Triangle> triangles_;
+    std::vector<std::vector<uint32_t>> bins_;
+
+    void bin(const glm::vec4* clip) noexcept;
+    void rasterize(unsigned tile) noexcept;
+};
+
+}  // namespace neat
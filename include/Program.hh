@@ -18,29 +18,134 @@
 
 #define GLSL(_X_) "#version 320 es\nprecision mediump float;\n" #_X_
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <vector>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "GLResource.hh"
 
 namespace neat {
 
+class ProgramCache;
+
 struct ShaderInfo {
     unsigned int type;
     const char* source;
 };
 
+/** Location of a uniform of type T, resolved once; setting it is a single
+    glUniform call on the program in use. T is float, int, unsigned, a glm
+    vec2, vec3, vec4 or mat4; samplers are int */
+template <class T>
+class Uniform {
+    int location_ = -1;
+
+  public:
+    Uniform() = default;
+    explicit Uniform(int location) noexcept : location_(location) {
+    }
+
+    [[nodiscard]] bool valid() const noexcept {
+        return location_ >= 0;
+    }
+
+    [[nodiscard]] int location() const noexcept {
+        return location_;
+    }
+
+    void set(const T& value) const noexcept {
+        set(&value, 1);
+    }
+
+    void set(const T* values, std::size_t count) const noexcept;
+};
+
 class Program : private GLResource {
-    std ::unordered_map<std::string, unsigned int> uniforms_;
+    /** active uniforms by name, arrays without their [0] suffix */
+    struct Active {
+        std::string name;
+        int location;
+        unsigned type;
+    };
+
+    std::vector<Active> uniforms_;
+    std::vector<unsigned> shaders_;
+    std::unique_ptr<ProgramCache> cache_;
+    bool pending_ = false;
+
+    void start(const std::vector<ShaderInfo>& shaders,
+        std::string_view prelude) noexcept;
+    void reflect() noexcept;
+    [[nodiscard]] int find(std::string_view name, unsigned type) const noexcept;
 
   public:
-    explicit Program(const std::vector<ShaderInfo>& shaders) noexcept;
+    /** Async issues the compiles and the link without waiting for them,
+        the program is usable once ready() or finish() */
+    enum class Build { Now, Async };
+
+    /** 'prelude' is inserted after the #version line of every shader */
+    explicit Program(const std::vector<ShaderInfo>& shaders,
+        std::string_view prelude = {}, Build build = Build::Now) noexcept;
     Program(Program&& rhs) noexcept;
     Program& operator=(Program&& rhs) noexcept;
-    [[nodiscard]] unsigned int uniform(const char* name) noexcept;
+    ~Program() noexcept;
+
+    /** whether an Async build is done, finishing it then; without
+        GL_KHR_parallel_shader_compile this cannot tell and says true */
+    bool ready() noexcept;
+    /** waits for an Async build, logs how it went and looks up the
+        uniforms */
+    void finish() noexcept;
+    [[nodiscard]] bool pending() const noexcept;
+
+    /** handle of the active uniform 'name', invalid and logged when the
+        program has no such uniform of type T */
+    template <class T>
+    [[nodiscard]] Uniform<T> uniform(std::string_view name) const noexcept;
+
     [[nodiscard]] unsigned int getRawId() const noexcept;
     void use() const noexcept;
+
+    /** keeps linked binaries in 'directory' so that later runs skip
+        compiling; set before creating any program, empty disables it */
+    static void setCacheDirectory(std::string_view directory) noexcept;
+};
+
+/** Programs compiled from the same shaders with a prelude of constants
+    per key, the first time the key is asked for. The GLSL compiler folds
+    branches on those constants, so each variant only runs what its
+    features need. Requested variants build in the background while draws
+    use another one */
+class ProgramVariants : private NoCopy {
+  public:
+    using Prelude = std::string (*)(uint32_t key);
+
+  private:
+    std::vector<ShaderInfo> shaders_;
+    Prelude prelude_;
+    std::unordered_map<uint32_t, Program> programs_;
+
+  public:
+    ProgramVariants(std::vector<ShaderInfo> shaders, Prelude prelude) noexcept;
+
+    /** builds the variant on first use and waits for it, so only on the
+        render thread like everything below but find() */
+    Program& get(uint32_t key) noexcept;
+    /** starts building the variant unless it exists */
+    void request(uint32_t key) noexcept;
+    /** requests the variant, true once it is built */
+    bool ready(uint32_t key) noexcept;
+    /** finishes the variants built meanwhile, once per frame */
+    void poll() noexcept;
+    /** waits for every variant requested */
+    void finish() noexcept;
+    /** the variant when built already, nullptr otherwise; any thread may
+        look up while nothing else above runs */
+    [[nodiscard]] const Program* find(uint32_t key) const noexcept;
 };
 
 }  // namespace neat
@@ -0,0 +1,157 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include <glm/vec4.hpp>
+
+#include "NoCopy.hh"
+#include "PImpl.hh"
+
+namespace neat {
+
+/** One draw call recorded into a RenderQueue, raw GL names included; a
+    texture of 0 keeps the one bound before */
+struct RenderCommand {
+    enum class Kind : uint8_t { Arrays, Elements, ElementsIndirect };
+
+    Kind kind = Kind::Elements;
+    unsigned program = 0;
+    /** vertex array object, or 0 to read 4 floats per vertex of
+        vertexBuffer into attribute 0 */
+    unsigned vertexArray = 0;
+    unsigned vertexBuffer = 0;
+    unsigned indexBuffer = 0;
+    unsigned indexType = 0;
+    /** per instance matrices read from 'firstInstance' on, into the four
+        attributes starting at instanceAttrib */
+    unsigned instanceBuffer = 0;
+    unsigned instanceAttrib = 0;
+    unsigned firstInstance = 0;
+    unsigned indirectBuffer = 0;
+    unsigned texture = 0;
+    /** range of a uniform buffer bound to uniform block binding
+        blockBinding, none when blockBuffer is 0 */
+    unsigned blockBuffer = 0;
+    unsigned blockBinding = 0;
+    uint32_t blockOffset = 0;
+    uint32_t blockSize = 0;
+    unsigned count = 0;
+    unsigned instances = 1;
+    int baseVertex = 0;
+    /** first vertex for arrays, byte offset into the index or indirect
+        buffer otherwise */
+    std::size_t offset = 0;
+    uint32_t uniforms = 0;  // set by RenderQueue::List::add
+};
+
+/** Defers draw calls: they are recorded during the frame, sorted by a
+    64-bit key (pass, program, material, texture, depth) and replayed by
+    submit(), which only changes GL state that differs from the previous
+    command. Worker threads record lists of their own, which the render
+    thread merges before submitting */
+class RenderQueue : private NoCopy {
+  public:
+    /** drawn in this order: opaque front to back, transparent back to
+        front with blending, overlays in recording order with blending */
+    enum class Pass : uint8_t { Opaque, Transparent, Overlay };
+
+    /** float uniform of 'size' components */
+    struct Uniform {
+        int location;
+        unsigned size;
+        glm::vec4 value;
+    };
+
+    /** program, vertex layout and pass combination drawn by prewarm() */
+    struct Prewarmed {
+        unsigned program;
+        unsigned vertexArray;
+        Pass pass;
+        float milliseconds;
+    };
+
+    struct Stats {
+        unsigned commands = 0;   // draws replayed
+        unsigned changes = 0;    // bindings and uniforms set
+        unsigned redundant = 0;  // bindings and uniforms already current
+    };
+
+    /** Commands of one recording thread, kept in a linear allocator of
+        its own that is reused every frame; recording makes no GL call */
+    class List : private NoCopy {
+        friend class RenderQueue;
+        class Impl;
+
+        PImpl<Impl, 88, 8> pImpl_;
+
+      public:
+        List() noexcept;
+        ~List() noexcept;
+
+        /** records 'command' with uniforms set before it; 'depth' is the
+            view space distance used to order the pass */
+        void add(Pass pass, float depth, const RenderCommand& command,
+            std::initializer_list<Uniform> uniforms = {}) noexcept;
+        /** replaces the data of array buffer 'buffer' before the draws;
+            the instances of the commands recorded after it in this list
+            come from it, even when other lists upload the same buffer */
+        void upload(
+            unsigned buffer, const void* data, std::size_t size) noexcept;
+        void clear() noexcept;
+
+        [[nodiscard]] std::size_t size() const noexcept;
+    };
+
+  private:
+    class Impl;
+
+    PImpl<Impl, 496, 8> pImpl_;
+
+  public:
+    RenderQueue() noexcept;
+    ~RenderQueue() noexcept;
+
+    /** list recorded on the render thread, submitted first */
+    [[nodiscard]] List& list() noexcept;
+    /** submits 'list' too, after the lists merged before it; it must not
+        change until then */
+    void merge(List& list) noexcept;
+    /** sorts and issues the commands of every list, then clears them and
+        leaves vertex array 0 bound and blending disabled; overlays keep
+        the order of the lists and of the commands within them */
+    void submit() noexcept;
+    /** instead of submit() while loading: draws one command of every
+        program, vertex layout and pass combination recorded into a tiny
+        offscreen framebuffer with the formats of the one bound, waiting
+        for each, so that drivers finish compiling them before the first
+        frame showing them. Puts back the bindings and blending it found;
+        uniform values of the programs drawn keep the recorded ones */
+    std::vector<Prewarmed> prewarm() noexcept;
+    void clear() noexcept;
+
+    /** commands recorded so far in every list */
+    [[nodiscard]] std::size_t size() const noexcept;
+    /** counters of the last submit */
+    [[nodiscard]] const Stats& stats() const noexcept;
+};
+
+}  // namespace neat
@@ -0,0 +1,95 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "NoCopy.hh"
+
+namespace neat {
+
+struct Box {
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+};
+
+struct RayHit {
+    uint32_t data;
+    float distance;
+};
+
+/** Dynamic bounding volume hierarchy over boxes of scene objects. Leaves
+    keep a loose box, so small moves only touch the leaf and larger ones
+    reinsert it; the tree stays height balanced */
+class SpatialIndex : private NoCopy {
+    struct Node {
+        Box box;
+        int parent = -1;
+        int children[2] = {-1, -1};
+        int height = 0;
+        uint32_t data = 0;
+
+        [[nodiscard]] bool leaf() const noexcept {
+            return children[0] == -1;
+        }
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<int> free_;
+    int root_ = -1;
+    float margin_;
+
+    int allocate() noexcept;
+    void insertLeaf(int leaf) noexcept;
+    void removeLeaf(int leaf) noexcept;
+    int balance(int node) noexcept;
+    void refit(int node) noexcept;
+
+  public:
+    /** leaves grow by 'margin' times their size on every side */
+    explicit SpatialIndex(float margin = 0.1f) noexcept;
+
+    /** returns an id for update() and remove() */
+    int insert(const Box& box, uint32_t data) noexcept;
+    void update(int id, const Box& box) noexcept;
+    void remove(int id) noexcept;
+    void clear() noexcept;
+
+    /** data of objects whose box touches the frustum of 'vp' */
+    void query(const glm::mat4& vp, std::vector<uint32_t>& result) const
+        noexcept;
+    /** data of objects whose box touches the sphere */
+    void query(const glm::vec3& center, float radius,
+        std::vector<uint32_t>& result) const noexcept;
+    /** nearest object along the ray for which 'hit' returns a distance,
+        in units of 'direction'; objects are visited front to back and
+        only while their box is closer than the best hit so far */
+    [[nodiscard]] std::optional<RayHit> raycast(const glm::vec3& origin,
+        const glm::vec3& direction,
+        const std::function<std::optional<float>(uint32_t)>& hit) const
+        noexcept;
+
+    [[nodiscard]] int height() const noexcept;
+};
+
+}  // namespace neat
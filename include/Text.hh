@@ -19,16 +19,29 @@
 #include <vector>
 #include <optional>
 
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
 #include "Font.hh"
 #include "Buffer.hh"
 #include "Program.hh"
+#include "RenderQueue.hh"
 
 namespace neat {
 
 class Text : private NoCopy {
     Buffer buffer_;
     const Font& font_;
+    unsigned count_ = 0;
     inline static std::optional<Program> program_;
+    inline static Uniform<glm::vec2> shiftUniform_;
+    inline static Uniform<glm::vec4> colorUniform_;
+    // set by move and setColor, applied by every render
+    inline static glm::vec2 shift_{0.f};
+    inline static glm::vec4 color_{0.f};
+
+    static void initProgram();
+    static void setUniforms() noexcept;
 
     explicit Text(const Font& font) noexcept;
 
@@ -44,6 +57,9 @@ class Text : private NoCopy {
     Text(const std::vector<Entry>&, const Font& font) noexcept;
     Text(Text&& other) noexcept;
     void render() const noexcept;
+    /** records the text into 'list' with the current color and shift,
+        without GL calls */
+    void render(RenderQueue::List& list) const noexcept;
     static void move(float x, float y) noexcept;
     static void setColor(float r, float g, float b);
     static void draw(std::string_view text, const Font& font, float x, float y);
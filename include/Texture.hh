@@ -29,6 +29,7 @@ class Texture : private GLResource {
     Texture(Texture&& rhs) noexcept;
     Texture& operator=(Texture&& rhs) noexcept;
     void bind() const noexcept;
+    [[nodiscard]] unsigned int getRawId() const noexcept;
     static void unbind();
     ~Texture();
 };
@@ -0,0 +1,42 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace neat::transform {
+
+/** Batch matrix operations for building instance arrays, using the
+    widest SIMD kernels the CPU supports (AVX2, SSE4.1 or scalar).
+    Arrays need no particular alignment; 'result' may alias an input */
+
+/** result[i] = a[i] * b[i], e.g. parent world times local */
+void multiply(const glm::mat4* a, const glm::mat4* b, glm::mat4* result,
+    std::size_t count) noexcept;
+/** result[i] = a * b[i], e.g. view times model */
+void multiply(const glm::mat4& a, const glm::mat4* b, glm::mat4* result,
+    std::size_t count) noexcept;
+/** inverse transpose of the upper 3x3 of every matrix, for normals */
+void normalMatrices(
+    const glm::mat4* m, glm::mat3* result, std::size_t count) noexcept;
+/** name of the kernels in use */
+[[nodiscard]] const char* kernels() noexcept;
+
+}  // namespace neat::transform
@@ -0,0 +1,64 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "NoCopy.hh"
+
+namespace neat {
+
+/** Local and world transforms of a node hierarchy, kept in contiguous
+    arrays sorted by depth so parents always come before their children.
+    update() recomputes only the nodes whose local transform or ancestors
+    changed; gather() collects world matrices for Model::setPos */
+class TransformHierarchy : private NoCopy {
+    std::vector<glm::mat4> local_;
+    std::vector<glm::mat4> world_;
+    std::vector<uint32_t> parent_;  // slot of the parent
+    std::vector<uint32_t> depth_;
+    std::vector<uint32_t> node_;    // node stored in a slot
+    std::vector<uint32_t> slot_;    // slot of a node
+    std::vector<uint8_t> dirty_;
+    std::vector<uint8_t> changed_;  // world changed by the last update
+    std::vector<uint32_t> levels_;  // first slot of every depth
+    bool sorted_ = true;
+
+    void sort();
+
+  public:
+    static constexpr uint32_t none = ~0u;
+
+    /** returns the new node, whose parent must already exist */
+    uint32_t add(const glm::mat4& local, uint32_t parent = none);
+    void setLocal(uint32_t node, const glm::mat4& local) noexcept;
+    [[nodiscard]] const glm::mat4& local(uint32_t node) const noexcept;
+    [[nodiscard]] const glm::mat4& world(uint32_t node) const noexcept;
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    /** recomputes changed world matrices, returning how many */
+    std::size_t update();
+    /** world matrices of 'nodes', returning whether any of them changed in
+        the last update */
+    bool gather(const std::vector<uint32_t>& nodes,
+        std::vector<glm::mat4>& result) const;
+};
+
+}  // namespace neat
@@ -36,3 +36,7 @@ void queryData(NeatWindowData* data);
 void init(int argc, char* argv[]);
 int action(neat::Actions act, int x, int y);
 void draw(uint64_t);
+/** called before main returns, while the context is still current;
+    optional, the platform layer defines an empty one applications may
+    replace */
+void deinit();
@@ -72,7 +72,7 @@ Billboard::Billboard(Billboard&& rhs) noexcept :
 }
 
 void Billboard::render(const Texture& texture) const noexcept {
-    Blending blenging;
+    Blending blending;
     texture.bind();
     buffer_.bind();
     program_->use();
@@ -80,8 +80,19 @@ void Billboard::render(const Texture& texture) const noexcept {
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+void Billboard::render(
+    RenderQueue::List& list, const Texture& texture) const noexcept {
+    RenderCommand command;
+    command.kind = RenderCommand::Kind::Arrays;
+    command.program = program_->getRawId();
+    command.vertexBuffer = buffer_.getRawId();
+    command.texture = texture.getRawId();
+    command.count = 6;
+    list.add(RenderQueue::Pass::Overlay, 0.f, command);
+}
+
 void Billboard::draw(const glm::vec4& rect, const Texture& texture) {
-    Blending blenging;
+    Blending blending;
     texture.bind();
     Buffer::unbind(Buffer::Target::Array);
     program_->use();
@@ -17,15 +17,25 @@
 #pragma once
 
 #include <GLES3/gl3.h>
+
+#include <GLState.hh>
 #include <NoCopy.hh>
 
-// TODO: consider shader-based alpha-blending
-class Blending : private neat::NoCopy {
+namespace neat {
+
+/** Enables blending for one draw and puts back what the caller had;
+    consecutive overlays stay blended without a state change */
+class Blending : private NoCopy {
+    bool enabled_;
+
   public:
-    Blending() noexcept {
-        glEnable(GL_BLEND);
+    Blending() noexcept : enabled_(GLState::instance().enabled(GL_BLEND)) {
+        GLState::instance().enable(GL_BLEND, true);
     }
+
     ~Blending() noexcept {
-        glDisable(GL_BLEND);
+        GLState::instance().enable(GL_BLEND, enabled_);
     }
 };
+
+}  // namespace neat
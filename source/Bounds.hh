@@ -0,0 +1,66 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+namespace neat {
+
+/** Axis aligned box and bounding sphere (center, radius) of a point set */
+struct Bounds {
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+    glm::vec4 sphere{0.f};
+
+    /** 'point(i)' returns the i-th of 'count' points */
+    template <class Func>
+    static Bounds of(std::size_t count, Func point) noexcept {
+        Bounds bounds;
+        if (count == 0) {
+            return bounds;
+        }
+        bounds.min = bounds.max = point(0);
+        for (std::size_t i = 1; i < count; ++i) {
+            bounds.min = glm::min(bounds.min, point(i));
+            bounds.max = glm::max(bounds.max, point(i));
+        }
+        auto center = (bounds.min + bounds.max) / 2.f;
+        auto radius = 0.f;
+        for (std::size_t i = 0; i < count; ++i) {
+            radius = std::max(radius, glm::distance(center, point(i)));
+        }
+        bounds.sphere = glm::vec4(center, radius);
+        return bounds;
+    }
+};
+
+/** largest axis scale of an affine transform */
+inline float maxScale(const glm::mat4& m) noexcept {
+    return std::max({glm::length(glm::vec3(m[0])),
+        glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))});
+}
+
+inline glm::vec4 transformSphere(
+    const glm::vec4& sphere, const glm::mat4& m) noexcept {
+    auto center = m * glm::vec4(glm::vec3(sphere), 1.f);
+    return glm::vec4(glm::vec3(center), sphere.w * maxScale(m));
+}
+
+}  // namespace neat
@@ -19,6 +19,7 @@
 #include <GLES3/gl3.h>
 
 #include <Buffer.hh>
+#include <GLState.hh>
 
 namespace neat {
 
@@ -40,20 +41,32 @@ Buffer& Buffer::operator=(Buffer&& rhs) noexcept {
 
 Buffer::~Buffer() {
     if (id_ != 0) {
+        GLState::instance().deleteBuffer(id_);
         glDeleteBuffers(1, &id_);
     }
 }
 
 void Buffer::bind() const noexcept {
-    glBindBuffer(static_cast<GLenum>(target_), id_);
+    GLState::instance().bindBuffer(static_cast<GLenum>(target_), id_);
 }
 
 void Buffer::unbind() const noexcept {
-    glBindBuffer(static_cast<GLenum>(target_), 0);
+    GLState::instance().bindBuffer(static_cast<GLenum>(target_), 0);
+}
+
+void Buffer::bindBase(Target target, unsigned index) const noexcept {
+    GLState::instance().bindBufferBase(
+        static_cast<GLenum>(target), index, id_);
+}
+
+void Buffer::bindRange(Target target, unsigned index, std::size_t offset,
+    std::size_t size) const noexcept {
+    GLState::instance().bindBufferRange(
+        static_cast<GLenum>(target), index, id_, offset, size);
 }
 
 void Buffer::unbind(Target target) {
-    glBindBuffer(static_cast<GLenum>(target), 0);
+    GLState::instance().bindBuffer(static_cast<GLenum>(target), 0);
 }
 
 void Buffer::set(const void* data, std::size_t size) const noexcept {
@@ -61,10 +74,20 @@ void Buffer::set(const void* data, std::size_t size) const noexcept {
         dynamic_ ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 }
 
+void Buffer::update(
+    std::size_t offset, const void* data, std::size_t size) const noexcept {
+    glBufferSubData(static_cast<GLenum>(target_),
+        static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+}
+
 unsigned Buffer::size() const noexcept {
     GLint ret;
     glGetBufferParameteriv(static_cast<GLenum>(target_), GL_BUFFER_SIZE, &ret);
     return ret;
 }
 
+unsigned int Buffer::getRawId() const noexcept {
+    return id_;
+}
+
 }  // namespace neat
@@ -0,0 +1,199 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NEAT_CULL_X86
+#endif
+
+namespace neat {
+
+/** View frustum planes (normal, distance) pointing inside */
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    static Frustum fromMatrix(const glm::mat4& vp) noexcept {
+        auto row = [&vp](int i) {
+            return glm::vec4(vp[0][i], vp[1][i], vp[2][i], vp[3][i]);
+        };
+        Frustum frustum{{row(3) + row(0), row(3) - row(0), row(3) + row(1),
+            row(3) - row(1), row(3) + row(2), row(3) - row(2)}};
+        for (auto& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+};
+
+/** Bounding spheres as separate coordinate arrays, so the culling
+    kernels load one coordinate of several spheres at once */
+struct Spheres {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    void resize(std::size_t count) {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        radius.resize(count);
+    }
+
+    void set(std::size_t i, const glm::vec4& sphere) noexcept {
+        x[i] = sphere.x;
+        y[i] = sphere.y;
+        z[i] = sphere.z;
+        radius[i] = sphere.w;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return x.size();
+    }
+};
+
+namespace culling {
+
+/** Kernels write the indices of the spheres in [begin, end) touching the
+    frustum to 'visible' and return how many there are */
+using Kernel = std::size_t (*)(const Frustum& frustum, const Spheres& spheres,
+    std::size_t begin, std::size_t end, uint32_t* visible);
+
+inline std::size_t scalar(const Frustum& frustum, const Spheres& spheres,
+    std::size_t begin, std::size_t end, uint32_t* visible) {
+    std::size_t count = 0;
+    for (auto i = begin; i < end; ++i) {
+        auto inside = true;
+        for (const auto& p : frustum.planes) {
+            inside &= p.x * spheres.x[i] + p.y * spheres.y[i] +
+                          p.z * spheres.z[i] + p.w >=
+                      -spheres.radius[i];
+        }
+        visible[count] = static_cast<uint32_t>(i);
+        count += inside ? 1 : 0;
+    }
+    return count;
+}
+
+#ifdef NEAT_CULL_X86
+
+#define NEAT_SSE2 __attribute__((target("sse2")))
+#define NEAT_AVX2 __attribute__((target("avx2")))
+
+/** 4 spheres per iteration, only called when the CPU reports SSE2 */
+NEAT_SSE2 inline std::size_t sse(const Frustum& frustum,
+    const Spheres& spheres, std::size_t begin, std::size_t end,
+    uint32_t* visible) {
+    __m128 planes[6][4];
+    for (auto p = 0u; p < 6; ++p) {
+        for (auto c = 0u; c < 4; ++c) {
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+        }
+    }
+    std::size_t count = 0;
+    auto i = begin;
+    for (; i + 4 <= end; i += 4) {
+        auto x = _mm_loadu_ps(&spheres.x[i]);
+        auto y = _mm_loadu_ps(&spheres.y[i]);
+        auto z = _mm_loadu_ps(&spheres.z[i]);
+        auto r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& p : planes) {
+            auto d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, p[0]), _mm_mul_ps(y, p[1])),
+                _mm_add_ps(_mm_mul_ps(z, p[2]), p[3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, r));
+        }
+        auto mask = static_cast<unsigned>(_mm_movemask_ps(inside));
+        while (mask != 0) {
+            visible[count++] = static_cast<uint32_t>(i) + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return count + scalar(frustum, spheres, i, end, visible + count);
+}
+
+/** 8 spheres per iteration, only called when the CPU reports AVX2 */
+NEAT_AVX2 inline std::size_t avx2(const Frustum& frustum,
+    const Spheres& spheres, std::size_t begin, std::size_t end,
+    uint32_t* visible) {
+    __m256 planes[6][4];
+    for (auto p = 0u; p < 6; ++p) {
+        for (auto c = 0u; c < 4; ++c) {
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        }
+    }
+    std::size_t count = 0;
+    auto i = begin;
+    for (; i + 8 <= end; i += 8) {
+        auto x = _mm256_loadu_ps(&spheres.x[i]);
+        auto y = _mm256_loadu_ps(&spheres.y[i]);
+        auto z = _mm256_loadu_ps(&spheres.z[i]);
+        auto r = _mm256_sub_ps(
+            _mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& p : planes) {
+            auto d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, p[0]), _mm256_mul_ps(y, p[1])),
+                _mm256_add_ps(_mm256_mul_ps(z, p[2]), p[3]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, r, _CMP_GE_OQ));
+        }
+        auto mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+        while (mask != 0) {
+            visible[count++] = static_cast<uint32_t>(i) + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return count + scalar(frustum, spheres, i, end, visible + count);
+}
+
+#endif
+
+/** widest kernel the running CPU supports */
+inline Kernel select() noexcept {
+#ifdef NEAT_CULL_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return sse;
+    }
+    return scalar;
+#else
+    return scalar;
+#endif
+}
+
+}  // namespace culling
+
+/** Writes the indices of the first 'count' spheres touching the frustum to
+    'visible', which must hold 'count' entries, and returns how many */
+inline std::size_t cull(const Frustum& frustum, const Spheres& spheres,
+    std::size_t count, uint32_t* visible) noexcept {
+    static const auto kernel = culling::select();
+    return kernel(frustum, spheres, 0, count, visible);
+}
+
+}  // namespace neat
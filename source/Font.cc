@@ -197,6 +197,10 @@ class Font::Impl {
     void unbind() const noexcept {
         atlas_->unbind();
     }
+
+    [[nodiscard]] unsigned int getRawTextureId() const noexcept {
+        return atlas_->getRawId();
+    }
 };
 
 Font::Font(const void* data, std::size_t size, int height) noexcept :
@@ -219,6 +223,10 @@ void Font::unbind() const noexcept {
     pImpl_->unbind();
 }
 
+unsigned int Font::getRawTextureId() const noexcept {
+    return pImpl_->getRawTextureId();
+}
+
 float Font::centerX(std::string_view str) const noexcept {
     return pImpl_->centerX(str);
 }
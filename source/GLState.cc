@@ -0,0 +1,222 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <GLES3/gl32.h>
+
+#include <GLState.hh>
+
+namespace neat {
+
+namespace {
+
+constexpr auto None = ~0u;
+
+unsigned targetIndex(unsigned target) noexcept {
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            return 0;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return 1;
+        case GL_DRAW_INDIRECT_BUFFER:
+            return 2;
+        case GL_SHADER_STORAGE_BUFFER:
+            return 3;
+        case GL_UNIFORM_BUFFER:
+            return 4;
+        default:
+            return None;
+    }
+}
+
+unsigned capIndex(unsigned cap) noexcept {
+    switch (cap) {
+        case GL_BLEND:
+            return 0;
+        case GL_DEPTH_TEST:
+            return 1;
+        case GL_CULL_FACE:
+            return 2;
+        default:
+            return None;
+    }
+}
+
+}  // namespace
+
+GLState::GLState() noexcept {
+    invalidate();
+}
+
+GLState& GLState::instance() noexcept {
+    static GLState state;
+    return state;
+}
+
+bool GLState::change(unsigned& current, unsigned value) noexcept {
+    if (current == value) {
+        ++stats_.elided;
+        return false;
+    }
+    current = value;
+    ++stats_.issued;
+    return true;
+}
+
+void GLState::useProgram(unsigned program) noexcept {
+    if (change(program_, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLState::bindVertexArray(unsigned vertexArray) noexcept {
+    if (change(vertexArray_, vertexArray)) {
+        glBindVertexArray(vertexArray);
+        // the element array binding belongs to the vertex array
+        buffers_[ElementArray] = Unknown;
+    }
+}
+
+void GLState::bindBuffer(unsigned target, unsigned buffer) noexcept {
+    auto index = targetIndex(target);
+    if (index == None) {
+        ++stats_.issued;
+        glBindBuffer(target, buffer);
+    } else if (change(buffers_[index], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bindBufferBase(
+    unsigned target, unsigned index, unsigned buffer) noexcept {
+    ++stats_.issued;
+    glBindBufferBase(target, index, buffer);
+    auto generic = targetIndex(target);
+    if (generic != None) {
+        buffers_[generic] = buffer;
+    }
+    if (target == GL_UNIFORM_BUFFER && index < Blocks) {
+        // the whole buffer, which no range compares equal to
+        blocks_[index] = {buffer, 0, 0};
+    }
+}
+
+void GLState::bindBufferRange(unsigned target, unsigned index,
+    unsigned buffer, std::size_t offset, std::size_t size) noexcept {
+    if (target == GL_UNIFORM_BUFFER && index < Blocks) {
+        auto& bound = blocks_[index];
+        if (bound.buffer == buffer && bound.offset == offset &&
+            bound.size == size) {
+            ++stats_.elided;
+            return;
+        }
+        bound = {buffer, offset, size};
+    }
+    ++stats_.issued;
+    glBindBufferRange(target, index, buffer, static_cast<GLintptr>(offset),
+        static_cast<GLsizeiptr>(size));
+    auto generic = targetIndex(target);
+    if (generic != None) {
+        buffers_[generic] = buffer;
+    }
+}
+
+void GLState::bindTexture(unsigned unit, unsigned texture) noexcept {
+    if (unit >= Units) {
+        stats_.issued += 2;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        unit_ = unit;
+        return;
+    }
+    // texture parameters and uploads that follow use the active unit
+    if (change(unit_, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    if (change(textures_[unit], texture)) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+}
+
+void GLState::enable(unsigned cap, bool enabled) noexcept {
+    auto index = capIndex(cap);
+    if (index != None && !change(caps_[index], enabled ? 1 : 0)) {
+        return;
+    }
+    if (index == None) {
+        ++stats_.issued;
+    }
+    if (enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+}
+
+bool GLState::enabled(unsigned cap) noexcept {
+    auto index = capIndex(cap);
+    if (index != None && caps_[index] != Unknown) {
+        return caps_[index] != 0;
+    }
+    auto result = glIsEnabled(cap) != GL_FALSE;
+    if (index != None) {
+        caps_[index] = result ? 1 : 0;
+    }
+    return result;
+}
+
+void GLState::deleteBuffer(unsigned buffer) noexcept {
+    for (auto& bound : buffers_) {
+        if (bound == buffer) {
+            bound = 0;
+        }
+    }
+    for (auto& bound : blocks_) {
+        if (bound.buffer == buffer) {
+            bound = {0, 0, 0};
+        }
+    }
+}
+
+void GLState::deleteTexture(unsigned texture) noexcept {
+    for (auto& bound : textures_) {
+        if (bound == texture) {
+            bound = 0;
+        }
+    }
+}
+
+void GLState::deleteVertexArray(unsigned vertexArray) noexcept {
+    if (vertexArray_ == vertexArray) {
+        vertexArray_ = 0;
+        buffers_[ElementArray] = Unknown;
+    }
+}
+
+void GLState::invalidate() noexcept {
+    program_ = vertexArray_ = unit_ = Unknown;
+    buffers_.fill(Unknown);
+    textures_.fill(Unknown);
+    caps_.fill(Unknown);
+    blocks_.fill({Unknown, 0, 0});
+}
+
+GLState::Stats GLState::stats() noexcept {
+    auto result = stats_;
+    stats_ = {};
+    return result;
+}
+
+}  // namespace neat
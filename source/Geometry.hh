@@ -0,0 +1,238 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ModelData.hh"
+#include "NoCopy.hh"
+
+namespace neat {
+
+/** Positions and indices kept on the CPU after upload for geometry
+    queries, shared by every model loaded from the same file. Each
+    coordinate is a separate cache line aligned array, optionally of 16-bit
+    values relative to the bounds, followed in the same block by the
+    indices, 16-bit when every vertex can be addressed that way */
+class Geometry : private NoCopy {
+    struct alignas(64) CacheLine {
+        std::byte bytes[64];
+    };
+
+  public:
+    /** triangle indices stored in the block, as absolute vertex indices */
+    class Indices {
+        const std::byte* data_;
+        std::size_t size_;
+        bool wide_;
+
+      public:
+        Indices(const std::byte* data, std::size_t size, bool wide) noexcept :
+            data_(data),
+            size_(size),
+            wide_(wide) {
+        }
+
+        [[nodiscard]] uint32_t operator[](std::size_t i) const noexcept {
+            return wide_ ? reinterpret_cast<const uint32_t*>(data_)[i]
+                         : reinterpret_cast<const uint16_t*>(data_)[i];
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return size_;
+        }
+    };
+
+  private:
+    std::vector<CacheLine> block_;
+    std::size_t vertices_;
+    std::size_t stride_;  // bytes from one coordinate array to the next
+    std::size_t indices_ = 0;
+    std::size_t coarse_ = 0;        // indices of the coarsest LOD, if any
+    std::size_t coarseOffset_ = 0;  // bytes from the block start
+    bool quantized_;
+    bool wide_;
+    glm::vec3 offset_{0.f};
+    glm::vec3 scale_{1.f};
+
+    static std::size_t lines(std::size_t bytes) noexcept {
+        return (bytes + sizeof(CacheLine) - 1) / sizeof(CacheLine);
+    }
+
+    static const MeshData::Indices& source(
+        const MeshData& mesh, bool coarsest) noexcept {
+        return coarsest && !mesh.lods.empty() ? mesh.lods.back()
+                                              : mesh.indices;
+    }
+
+    static std::size_t count(const ModelData& data, bool coarsest) noexcept {
+        std::size_t result = 0;
+        for (const auto& mesh : data.meshes) {
+            result += std::visit(
+                [](const auto& indices) { return indices.size(); },
+                source(mesh, coarsest));
+        }
+        return result;
+    }
+
+    template <class T>
+    [[nodiscard]] const T* at(std::size_t offset) const noexcept {
+        return reinterpret_cast<const T*>(
+            reinterpret_cast<const std::byte*>(block_.data()) + offset);
+    }
+
+    template <class T>
+    [[nodiscard]] T* at(std::size_t offset) noexcept {
+        return const_cast<T*>(std::as_const(*this).at<T>(offset));
+    }
+
+    template <class T>
+    [[nodiscard]] const T* coordinates(unsigned axis) const noexcept {
+        return at<T>(axis * stride_);
+    }
+
+    template <class T>
+    [[nodiscard]] T* coordinates(unsigned axis) noexcept {
+        return at<T>(axis * stride_);
+    }
+
+    template <class T>
+    static void append(const ModelData& data, bool coarsest, T* out) {
+        for (const auto& mesh : data.meshes) {
+            std::visit(
+                [&out, &mesh](const auto& indices) {
+                    for (auto index : indices) {
+                        *out++ = static_cast<T>(index + mesh.baseVertex);
+                    }
+                },
+                source(mesh, coarsest));
+        }
+    }
+
+    void fill(const ModelData& data, bool coarsest, std::size_t offset) {
+        if (wide_) {
+            append(data, coarsest, at<uint32_t>(offset));
+        } else {
+            append(data, coarsest, at<uint16_t>(offset));
+        }
+    }
+
+  public:
+    Geometry(const ModelData& data, bool quantize) :
+        vertices_(data.vertices.size()),
+        stride_(0),
+        indices_(count(data, false)),
+        quantized_(quantize),
+        wide_(vertices_ > 0x10000) {
+        auto lods = std::any_of(data.meshes.begin(), data.meshes.end(),
+            [](const auto& mesh) { return !mesh.lods.empty(); });
+        coarse_ = lods ? count(data, true) : 0;
+        auto size = quantize ? sizeof(uint16_t) : sizeof(float);
+        auto indexSize = wide_ ? sizeof(uint32_t) : sizeof(uint16_t);
+        stride_ = lines(vertices_ * size) * sizeof(CacheLine);
+        coarseOffset_ =
+            3 * stride_ + lines(indices_ * indexSize) * sizeof(CacheLine);
+        block_.resize(coarseOffset_ / sizeof(CacheLine) +
+                      lines(coarse_ * indexSize));
+
+        if (quantize) {
+            offset_ = data.bounds.min;
+            scale_ = (data.bounds.max - data.bounds.min) / 65535.f;
+        }
+        for (auto axis = 0u; axis < 3; ++axis) {
+            if (!quantize) {
+                auto* out = coordinates<float>(axis);
+                for (std::size_t i = 0; i < vertices_; ++i) {
+                    out[i] = data.vertices[i][axis];
+                }
+                continue;
+            }
+            auto* out = coordinates<uint16_t>(axis);
+            auto inverse = scale_[axis] > 0.f ? 1.f / scale_[axis] : 0.f;
+            for (std::size_t i = 0; i < vertices_; ++i) {
+                auto value = (data.vertices[i][axis] - offset_[axis]) * inverse;
+                out[i] = static_cast<uint16_t>(
+                    std::lround(std::clamp(value, 0.f, 65535.f)));
+            }
+        }
+
+        fill(data, false, 3 * stride_);
+        if (coarse_ != 0) {
+            fill(data, true, coarseOffset_);
+        }
+    }
+
+    [[nodiscard]] std::size_t vertices() const noexcept {
+        return vertices_;
+    }
+
+    [[nodiscard]] glm::vec3 position(uint32_t index) const noexcept {
+        if (!quantized_) {
+            return {coordinates<float>(0)[index], coordinates<float>(1)[index],
+                coordinates<float>(2)[index]};
+        }
+        return offset_ + scale_ * glm::vec3(coordinates<uint16_t>(0)[index],
+                                      coordinates<uint16_t>(1)[index],
+                                      coordinates<uint16_t>(2)[index]);
+    }
+
+    /** full detail triangles of all meshes */
+    [[nodiscard]] Indices indices() const noexcept {
+        return {at<std::byte>(3 * stride_), indices_, wide_};
+    }
+
+    /** triangles of the coarsest LOD */
+    [[nodiscard]] Indices coarse() const noexcept {
+        return coarse_ == 0 ? indices()
+                            : Indices{at<std::byte>(coarseOffset_), coarse_,
+                                  wide_};
+    }
+
+    [[nodiscard]] std::size_t memory() const noexcept {
+        return block_.size() * sizeof(CacheLine);
+    }
+};
+
+/** The coarsest LOD of a Geometry with the positions of only the vertices
+    it uses, rasterized into an OcclusionBuffer every frame */
+struct Occluder {
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    explicit Occluder(const Geometry& geometry) {
+        auto coarse = geometry.coarse();
+        std::vector<uint32_t> remap(geometry.vertices(), ~0u);
+        indices.reserve(coarse.size());
+        for (std::size_t i = 0; i < coarse.size(); ++i) {
+            auto& vertex = remap[coarse[i]];
+            if (vertex == ~0u) {
+                vertex = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(geometry.position(coarse[i]));
+            }
+            indices.push_back(vertex);
+        }
+    }
+};
+
+}  // namespace neat
@@ -0,0 +1,259 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <GLES3/gl31.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <Buffer.hh>
+#include <GLState.hh>
+#include <HiZ.hh>
+#include <Program.hh>
+
+#include "Culling.hh"
+#include "Mesh.hh"
+#include "ModelData.hh"
+
+namespace neat {
+
+// clang-format off
+inline const char* gpuCullingC = GLSL(
+
+precision highp float;
+precision highp sampler2D;
+
+layout (local_size_x = 64) in;
+
+const uint maxLods = 8u;
+
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint reserved;
+};
+
+layout (std430, binding = 0) readonly buffer Input {
+    mat4 instances[];
+};
+
+layout (std430, binding = 1) writeonly buffer Output {
+    mat4 visible[];
+};
+
+layout (std430, binding = 2) buffer Commands {
+    Command commands[];
+};
+
+uniform uint count;
+uniform uint meshes;
+uniform uint lods;
+uniform vec4 sphere;
+uniform vec4 planes[6];
+uniform mat4 view;
+uniform mat4 vp;
+uniform float projScale;
+uniform float lodErrors[maxLods];
+uniform float screenError;
+uniform bool useHiZ;
+uniform sampler2D hiZ;
+
+bool occluded(vec3 center, float radius) {
+    vec2 minUV = vec2(1.);
+    vec2 maxUV = vec2(0.);
+    float depth = 1.;
+    for (int i = 0; i < 8; ++i) {
+        vec3 offset = vec3((i & 1) == 0 ? -1. : 1., (i & 2) == 0 ? -1. : 1.,
+                           (i & 4) == 0 ? -1. : 1.);
+        vec4 clip = vp * vec4(center + radius * offset, 1.);
+        if (clip.w <= 0.) {
+            return false;
+        }
+        vec3 ndc = clip.xyz / clip.w * 0.5 + 0.5;
+        minUV = min(minUV, ndc.xy);
+        maxUV = max(maxUV, ndc.xy);
+        depth = min(depth, ndc.z);
+    }
+    minUV = clamp(minUV, 0., 1.);
+    maxUV = clamp(maxUV, 0., 1.);
+    vec2 size = (maxUV - minUV) * vec2(textureSize(hiZ, 0));
+    float level = ceil(log2(max(max(size.x, size.y), 1.)));
+    float farthest = max(
+        max(textureLod(hiZ, minUV, level).r, textureLod(hiZ, maxUV, level).r),
+        max(textureLod(hiZ, vec2(minUV.x, maxUV.y), level).r,
+            textureLod(hiZ, vec2(maxUV.x, minUV.y), level).r));
+    return depth > farthest;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= count) {
+        return;
+    }
+    mat4 model = instances[index];
+    vec3 center = (model * vec4(sphere.xyz, 1.)).xyz;
+    float radius = sphere.w * max(max(length(model[0].xyz),
+        length(model[1].xyz)), length(model[2].xyz));
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius) {
+            return;
+        }
+    }
+    float distance = -(view * vec4(center, 1.)).z;
+    uint lod = 0u;
+    if (distance > radius) {
+        if (useHiZ && occluded(center, radius)) {
+            return;
+        }
+        float projected = radius * projScale / distance;
+        for (uint i = lods - 1u; i > 0u; --i) {
+            if (lodErrors[i - 1u] * projected <= screenError) {
+                lod = i;
+                break;
+            }
+        }
+    }
+    uint first = lod * meshes;
+    uint slot = atomicAdd(commands[first].instanceCount, 1u);
+    for (uint mesh = 1u; mesh < meshes; ++mesh) {
+        atomicAdd(commands[first + mesh].instanceCount, 1u);
+    }
+    visible[lod * count + slot] = model;
+}
+);
+// clang-format on
+
+/** Culls instances and picks their LOD in a compute pass, which writes the
+    visible transforms of LOD 'l' from instance 'l * count' of the output
+    buffer and one indirect draw command per LOD and mesh */
+class GpuCulling {
+    static constexpr unsigned maxLods = 8;
+
+    Buffer instances_{Buffer::Target::ShaderStorage};
+    Buffer commands_{Buffer::Target::DrawIndirect, true};
+    std::vector<Mesh::DrawCommand> commandTemplate_;
+    unsigned meshes_;
+    unsigned lods_;
+    unsigned count_ = 0;
+
+    /** the culling program and its uniforms, resolved once */
+    struct Shader {
+        Program program = Program({{GL_COMPUTE_SHADER, gpuCullingC}});
+        Uniform<unsigned> count = program.uniform<unsigned>("count");
+        Uniform<unsigned> meshes = program.uniform<unsigned>("meshes");
+        Uniform<unsigned> lods = program.uniform<unsigned>("lods");
+        Uniform<glm::vec4> sphere = program.uniform<glm::vec4>("sphere");
+        Uniform<glm::vec4> planes = program.uniform<glm::vec4>("planes");
+        Uniform<glm::mat4> view = program.uniform<glm::mat4>("view");
+        Uniform<glm::mat4> vp = program.uniform<glm::mat4>("vp");
+        Uniform<float> projScale = program.uniform<float>("projScale");
+        Uniform<float> lodErrors = program.uniform<float>("lodErrors");
+        Uniform<float> screenError = program.uniform<float>("screenError");
+        Uniform<int> useHiZ = program.uniform<int>("useHiZ");
+    };
+
+    static Shader& shader() noexcept {
+        static Shader shader;
+        return shader;
+    }
+
+  public:
+    explicit GpuCulling(const std::vector<Mesh>& meshes) noexcept :
+        meshes_(static_cast<unsigned>(meshes.size())),
+        lods_(meshes.empty() ? 1 : std::min(meshes[0].lods(), maxLods)) {
+        for (auto lod = 0u; lod < lods_; ++lod) {
+            for (const auto& mesh : meshes) {
+                commandTemplate_.push_back(mesh.command(lod));
+            }
+        }
+    }
+
+    [[nodiscard]] unsigned lods() const noexcept {
+        return lods_;
+    }
+
+    /** uploads the instances and sizes 'output' for every LOD */
+    void setInstances(
+        const std::vector<glm::mat4>& pos, const Buffer& output) noexcept {
+        count_ = static_cast<unsigned>(pos.size());
+        instances_.bind();
+        instances_.set(pos);
+        output.bind();
+        output.set(nullptr, pos.size() * lods_ * sizeof(glm::mat4));
+    }
+
+    void dispatch(const Buffer& output, unsigned count,
+        const glm::vec4& sphere, const std::vector<float>& lodErrors,
+        float screenError) noexcept {
+        count = std::min(count, count_);
+        const auto& scene = modelScene();
+        auto vp = scene.projection * scene.view;
+        auto frustum = Frustum::fromMatrix(vp);
+
+        auto& shader = GpuCulling::shader();
+        shader.program.use();
+        shader.count.set(count);
+        shader.meshes.set(meshes_);
+        shader.lods.set(lods_);
+        shader.sphere.set(sphere);
+        shader.planes.set(frustum.planes.data(), frustum.planes.size());
+        shader.view.set(scene.view);
+        shader.vp.set(vp);
+        shader.projScale.set(scene.projection[1][1]);
+        if (lods_ > 1) {
+            shader.lodErrors.set(lodErrors.data(),
+                std::min<std::size_t>(lodErrors.size(), lods_ - 1));
+        }
+        shader.screenError.set(screenError);
+        shader.useHiZ.set(scene.hiZ != nullptr ? 1 : 0);
+        if (scene.hiZ != nullptr) {
+            GLState::instance().bindTexture(0, scene.hiZ->getRawId());
+        }
+
+        commands_.bind();
+        commands_.set(commandTemplate_);
+        instances_.bindBase(Buffer::Target::ShaderStorage, 0);
+        output.bindBase(Buffer::Target::ShaderStorage, 1);
+        commands_.bindBase(Buffer::Target::ShaderStorage, 2);
+        glDispatchCompute((count + 63) / 64, 1, 1);
+        glMemoryBarrier(
+            GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        if (scene.hiZ != nullptr) {
+            GLState::instance().bindTexture(0, 0);
+        }
+    }
+
+    /** binds the commands written by the last dispatch */
+    void bindCommands() const noexcept {
+        commands_.bind();
+    }
+
+    [[nodiscard]] unsigned commandBuffer() const noexcept {
+        return commands_.getRawId();
+    }
+
+    [[nodiscard]] std::size_t commandOffset(
+        unsigned lod, unsigned mesh) const noexcept {
+        return (lod * meshes_ + mesh) * sizeof(Mesh::DrawCommand);
+    }
+};
+
+}  // namespace neat
@@ -0,0 +1,628 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <optional>
+#include <tuple>
+
+#include <GLES3/gl3.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <GLState.hh>
+#include <HLod.hh>
+#include <Log.hh>
+
+#include "MeshOptimizer.hh"
+#include "ModelData.hh"
+#include "Parallel.hh"
+#include "Simplifier.hh"
+#include "UniformBlocks.hh"
+
+namespace {
+
+const unsigned maxTiles = 64;
+
+// clang-format off
+const char* proxyV = GLSL(
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texcoord;
+layout (location = 3) in uint tile;
+
+layout (std140, binding = 0) uniform Camera {
+    highp mat4 view;
+    highp mat4 vp;
+};
+
+out vec2 uv;
+out vec3 vertNorm;
+flat out uint vertTile;
+
+void main() {
+    vertNorm = mat3(view) * normal;
+    gl_Position = vp * vec4(position, 1.0);
+    uv = texcoord;
+    vertTile = tile;
+}
+);
+
+const char* proxyF = GLSL(
+
+layout (location = 0) out vec4 color;
+
+const uint maxTiles = 64u;
+
+const uint maxLightCount = 16u;
+
+struct Sun {
+    vec3 color;
+    vec3 direction;
+};
+
+struct PointLight {
+    vec3 color;
+    vec3 position;
+    float attenuation;
+};
+
+layout (std140, binding = 1) uniform Lights {
+    Sun sun;
+    PointLight lights[maxLightCount];
+};
+
+uniform sampler2D atlas;
+uniform uint side;
+uniform float texel;
+uniform vec3 ambient[maxTiles];
+uniform vec3 diffuse[maxTiles];
+
+in vec2 uv;
+in vec3 vertNorm;
+flat in uint vertTile;
+
+void main() {
+    float scale = 1. / float(side);
+    vec2 origin = vec2(float(vertTile % side), float(vertTile / side));
+    vec2 local = clamp(fract(uv), texel, 1. - texel);
+    vec4 texColor = textureGrad(atlas, (origin + local) * scale,
+                                dFdx(uv) * scale, dFdy(uv) * scale);
+    vec3 vertColor = ambient[vertTile];
+    if (sun.color != vec3(0.)) {
+        float Kd = dot(normalize(vertNorm), normalize(-sun.direction));
+        vertColor += max(0., Kd) * sun.color * diffuse[vertTile];
+    }
+    color = vec4(vertColor, 1.0) * texColor;
+}
+);
+
+const char* bakeV = GLSL(
+
+out vec2 uv;
+
+void main() {
+    int id = gl_VertexID;
+    vec2 pos = vec2(float((id & 1) << 2), float((id & 2) << 1));
+    uv = pos / 2.;
+    gl_Position = vec4(pos - 1., 0., 1.);
+}
+);
+
+const char* bakeF = GLSL(
+
+layout (location = 0) out vec4 color;
+
+uniform sampler2D matTex;
+
+in vec2 uv;
+
+void main() {
+    color = texture(matTex, uv);
+}
+);
+// clang-format on
+
+struct ProxyVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texcoord;
+    uint32_t tile;
+};
+
+struct Proxy {
+    std::vector<ProxyVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct ProxyShader {
+    neat::Program program = neat::Program(
+        {{GL_FRAGMENT_SHADER, proxyF}, {GL_VERTEX_SHADER, proxyV}});
+    neat::Uniform<glm::vec3> ambient = program.uniform<glm::vec3>("ambient");
+    neat::Uniform<glm::vec3> diffuse = program.uniform<glm::vec3>("diffuse");
+    neat::Uniform<unsigned> side = program.uniform<unsigned>("side");
+    neat::Uniform<float> texel = program.uniform<float>("texel");
+};
+
+ProxyShader& proxyShader() noexcept {
+    static ProxyShader shader;
+    return shader;
+}
+
+neat::Program& bakeProgram() noexcept {
+    static auto program = neat::Program(
+        {{GL_FRAGMENT_SHADER, bakeF}, {GL_VERTEX_SHADER, bakeV}});
+    return program;
+}
+
+}  // namespace
+
+namespace neat {
+
+class HLod::Impl : private GLResource {
+    struct Source {
+        ModelData data;
+        ModelOptions options;
+        std::vector<glm::mat4> instances;
+        unsigned firstTile;
+    };
+
+    struct Instance {
+        unsigned model;
+        glm::mat4 transform;
+    };
+
+    struct Cluster {
+        glm::vec4 sphere{0.f};
+        std::vector<Instance> instances;
+        std::size_t offset = 0;
+        unsigned count = 0;
+    };
+
+    struct Range {
+        std::size_t offset;
+        unsigned count;
+    };
+
+    HLodOptions options_;
+    std::vector<Source> sources_;
+    std::vector<Model> models_;
+    std::vector<Cluster> clusters_;
+    Buffer vertices_;
+    Buffer indices_{Buffer::Target::ElementArray};
+    std::optional<Texture> atlas_;
+    std::vector<glm::vec3> ambient_;
+    std::vector<glm::vec3> diffuse_;
+    unsigned side_ = 1;
+    unsigned tileSize_ = 1;
+    mutable std::vector<std::vector<glm::mat4>> near_;
+    /** clusters drawn with full detail by the previous render */
+    mutable std::vector<bool> nearClusters_;
+    mutable std::vector<Range> ranges_;
+    mutable unsigned proxies_ = 0;
+
+    void assignTiles() noexcept {
+        for (auto& source : sources_) {
+            source.firstTile = static_cast<unsigned>(ambient_.size());
+            for (const auto& material : source.data.materials) {
+                ambient_.push_back(material.ambient());
+                diffuse_.push_back(material.diffuse());
+            }
+        }
+        if (ambient_.size() > maxTiles) {
+            Log() << "HLod: " << ambient_.size() << " materials, only "
+                  << maxTiles << " fit the atlas";
+            ambient_.resize(maxTiles);
+            diffuse_.resize(maxTiles);
+        }
+        while (side_ * side_ < ambient_.size()) {
+            ++side_;
+        }
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        auto maxTile = static_cast<unsigned>(maxSize) / side_;
+        tileSize_ = std::max(1u, std::min(options_.tileSize, maxTile));
+    }
+
+    void cluster() noexcept {
+        std::map<std::tuple<int, int, int>, std::size_t> cells;
+        for (auto model = 0u; model < sources_.size(); ++model) {
+            for (const auto& transform : sources_[model].instances) {
+                const auto& sphere = sources_[model].data.bounds.sphere;
+                auto center = transform * glm::vec4(glm::vec3(sphere), 1.f);
+                auto cell = glm::floor(glm::vec3(center) / options_.cellSize);
+                auto [it, inserted] = cells.try_emplace(
+                    std::make_tuple(static_cast<int>(cell.x),
+                        static_cast<int>(cell.y), static_cast<int>(cell.z)),
+                    clusters_.size());
+                if (inserted) {
+                    clusters_.emplace_back();
+                }
+                clusters_[it->second].instances.push_back({model, transform});
+            }
+        }
+
+        for (auto& cluster : clusters_) {
+            std::vector<glm::vec4> spheres;
+            spheres.reserve(cluster.instances.size());
+            auto min = glm::vec3(std::numeric_limits<float>::max());
+            auto max = -min;
+            for (const auto& [model, transform] : cluster.instances) {
+                auto sphere = transformSphere(
+                    sources_[model].data.bounds.sphere, transform);
+                min = glm::min(min, glm::vec3(sphere) - sphere.w);
+                max = glm::max(max, glm::vec3(sphere) + sphere.w);
+                spheres.push_back(sphere);
+            }
+            auto center = (min + max) / 2.f;
+            auto radius = 0.f;
+            for (const auto& sphere : spheres) {
+                radius = std::max(radius,
+                    glm::distance(center, glm::vec3(sphere)) + sphere.w);
+            }
+            cluster.sphere = glm::vec4(center, radius);
+        }
+    }
+
+    /** merges the coarsest LOD of every instance in world space and
+        simplifies the result as a whole */
+    [[nodiscard]] Proxy merge(const Cluster& cluster) const noexcept {
+        Proxy proxy;
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> remap;
+        for (const auto& [model, transform] : cluster.instances) {
+            const auto& source = sources_[model];
+            const auto& data = source.data;
+            auto normalMatrix =
+                glm::transpose(glm::inverse(glm::mat3(transform)));
+            for (const auto& mesh : data.meshes) {
+                // vertices are split per mesh, as each one keeps its tile
+                remap.assign(data.vertices.size(), ~0u);
+                auto tile = std::min(source.firstTile + mesh.material,
+                    static_cast<unsigned>(ambient_.size()) - 1);
+                auto addIndices = [&](const auto& indices) {
+                    for (auto index : indices) {
+                        auto v = index + mesh.baseVertex;
+                        if (remap[v] == ~0u) {
+                            remap[v] =
+                                static_cast<uint32_t>(proxy.vertices.size());
+                            auto pos = glm::vec3(
+                                transform * glm::vec4(data.vertices[v], 1.f));
+                            auto normal = v < data.normals.size()
+                                              ? data.normals[v]
+                                              : glm::vec3(0.f, 0.f, 1.f);
+                            auto texcoord = v < data.texcoords.size()
+                                                ? data.texcoords[v]
+                                                : glm::vec2(0.f);
+                            proxy.vertices.push_back({pos,
+                                glm::normalize(normalMatrix * normal), texcoord,
+                                tile});
+                            positions.push_back(pos);
+                        }
+                        proxy.indices.push_back(remap[v]);
+                    }
+                };
+                std::visit(addIndices,
+                    mesh.lods.empty() ? mesh.indices : mesh.lods.back());
+            }
+        }
+
+        proxy.indices = simplifier::simplify(
+            proxy.indices, positions, options_.error * options_.cellSize);
+        optimizer::optimizeVertexCache(proxy.indices);
+
+        remap.assign(proxy.vertices.size(), ~0u);
+        std::vector<ProxyVertex> vertices;
+        for (auto& index : proxy.indices) {
+            if (remap[index] == ~0u) {
+                remap[index] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(proxy.vertices[index]);
+            }
+            index = remap[index];
+        }
+        proxy.vertices = std::move(vertices);
+        return proxy;
+    }
+
+    void upload(std::vector<Proxy>& proxies) noexcept {
+        std::vector<ProxyVertex> vertices;
+        std::vector<uint32_t> indices;
+        for (auto i = 0u; i < clusters_.size(); ++i) {
+            auto base = static_cast<uint32_t>(vertices.size());
+            clusters_[i].offset = indices.size() * sizeof(uint32_t);
+            clusters_[i].count =
+                static_cast<unsigned>(proxies[i].indices.size());
+            vertices.insert(vertices.end(), proxies[i].vertices.begin(),
+                proxies[i].vertices.end());
+            for (auto index : proxies[i].indices) {
+                indices.push_back(base + index);
+            }
+            proxies[i] = {};
+        }
+
+        auto& state = GLState::instance();
+        // the proxies read the camera and lights blocks of the models
+        sceneBlocks();
+        glGenVertexArrays(1, &id_);
+        state.bindVertexArray(id_);
+        vertices_.bind();
+        vertices_.set(vertices);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ProxyVertex),
+            reinterpret_cast<const void*>(offsetof(ProxyVertex, position)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ProxyVertex),
+            reinterpret_cast<const void*>(offsetof(ProxyVertex, normal)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ProxyVertex),
+            reinterpret_cast<const void*>(offsetof(ProxyVertex, texcoord)));
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(ProxyVertex),
+            reinterpret_cast<const void*>(offsetof(ProxyVertex, tile)));
+        indices_.bind();
+        indices_.set(indices);
+        state.bindVertexArray(0);
+    }
+
+    /** renders every material into its atlas tile, untextured ones stay
+        white so the tile colors alone shade them */
+    void bake() noexcept {
+        auto size = side_ * tileSize_;
+        atlas_.emplace(nullptr, 4, size, size);
+
+        GLint framebuffer = 0;
+        GLint viewport[4];
+        GLfloat clearColor[4];
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        auto& state = GLState::instance();
+        auto depthTest = state.enabled(GL_DEPTH_TEST);
+        auto cullFace = state.enabled(GL_CULL_FACE);
+
+        GLuint fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, atlas_->getRawId(), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+            GL_FRAMEBUFFER_COMPLETE) {
+            state.enable(GL_DEPTH_TEST, false);
+            state.enable(GL_CULL_FACE, false);
+            glEnable(GL_SCISSOR_TEST);
+            glClearColor(1.f, 1.f, 1.f, 1.f);
+            auto& program = bakeProgram();
+            program.use();
+            for (const auto& source : sources_) {
+                const auto& materials = source.data.materials;
+                for (auto i = 0u; i < materials.size(); ++i) {
+                    auto tile = source.firstTile + i;
+                    if (tile >= ambient_.size()) {
+                        break;
+                    }
+                    auto x = static_cast<GLint>(tile % side_ * tileSize_);
+                    auto y = static_cast<GLint>(tile / side_ * tileSize_);
+                    glViewport(x, y, tileSize_, tileSize_);
+                    glScissor(x, y, tileSize_, tileSize_);
+                    if (materials[i].textured()) {
+                        materials[i].bind();
+                        glDrawArrays(GL_TRIANGLES, 0, 3);
+                    } else {
+                        glClear(GL_COLOR_BUFFER_BIT);
+                    }
+                }
+            }
+            glDisable(GL_SCISSOR_TEST);
+        } else {
+            Log() << "HLod: atlas framebuffer is incomplete";
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDeleteFramebuffers(1, &fbo);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glClearColor(
+            clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+        state.enable(GL_DEPTH_TEST, depthTest);
+        state.enable(GL_CULL_FACE, cullFace);
+
+        atlas_->bind();
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+            static_cast<GLint>(std::log2(tileSize_)));
+        Texture::unbind();
+    }
+
+    void renderProxies() const noexcept {
+        auto& shader = proxyShader();
+        shader.program.use();
+        shader.ambient.set(ambient_.data(), ambient_.size());
+        shader.diffuse.set(diffuse_.data(), diffuse_.size());
+        shader.side.set(side_);
+        shader.texel.set(0.5f / tileSize_);
+        atlas_->bind();
+
+        auto& state = GLState::instance();
+        state.enable(GL_BLEND, false);
+        state.bindVertexArray(id_);
+        for (const auto& range : ranges_) {
+            glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_INT,
+                reinterpret_cast<const void*>(range.offset));
+        }
+        state.bindVertexArray(0);
+    }
+
+  public:
+    explicit Impl(const HLodOptions& options) noexcept : options_(options) {
+    }
+
+    Impl(Impl&& rhs) noexcept = default;
+
+    ~Impl() noexcept {
+        if (id_ != 0) {
+            GLState::instance().deleteVertexArray(id_);
+            glDeleteVertexArrays(1, &id_);
+        }
+    }
+
+    void add(std::string_view filename,
+        const std::vector<glm::mat4>& instances,
+        const ModelOptions& options) noexcept {
+        if (!models_.empty()) {
+            Log() << "HLod: " << filename << " added after build";
+            return;
+        }
+        auto data = prepareModel(filename, options);
+        if (data.meshes.empty() || instances.empty()) {
+            return;
+        }
+        sources_.push_back({std::move(data), options, instances, 0});
+    }
+
+    void build() noexcept {
+        if (sources_.empty() || !models_.empty()) {
+            return;
+        }
+        assignTiles();
+        cluster();
+
+        std::vector<Proxy> proxies(clusters_.size());
+        parallelFor(
+            clusters_.size(), 1, [&](std::size_t begin, std::size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    proxies[i] = merge(clusters_[i]);
+                }
+            });
+        upload(proxies);
+        bake();
+
+        std::size_t instances = 0;
+        std::size_t triangles = 0;
+        for (auto& source : sources_) {
+            for (const auto& mesh : source.data.meshes) {
+                triangles += mesh.count() / 3 * source.instances.size();
+            }
+            instances += source.instances.size();
+            models_.push_back(
+                Model(std::move(source.data), std::move(source.options)));
+        }
+        std::size_t proxyTriangles = 0;
+        for (const auto& cluster : clusters_) {
+            proxyTriangles += cluster.count / 3;
+        }
+        Log() << "HLod: " << instances << " instances in " << clusters_.size()
+              << " proxies, triangles " << triangles << " -> "
+              << proxyTriangles;
+        near_.resize(models_.size());
+        nearClusters_.assign(clusters_.size(), false);
+        sources_.clear();
+    }
+
+    void render() const noexcept {
+        if (models_.empty()) {
+            return;
+        }
+        auto eye = glm::vec3(glm::inverse(modelScene().view)[3]);
+        ranges_.clear();
+        proxies_ = 0;
+        auto changed = false;
+        for (auto i = 0u; i < clusters_.size(); ++i) {
+            const auto& cluster = clusters_[i];
+            auto distance = glm::distance(eye, glm::vec3(cluster.sphere)) -
+                            cluster.sphere.w;
+            auto near = distance <= options_.distance || cluster.count == 0;
+            changed = changed || near != nearClusters_[i];
+            nearClusters_[i] = near;
+            if (near) {
+                continue;
+            }
+            if (!ranges_.empty() &&
+                ranges_.back().offset +
+                        ranges_.back().count * sizeof(uint32_t) ==
+                    cluster.offset) {
+                ranges_.back().count += cluster.count;
+            } else {
+                ranges_.push_back({cluster.offset, cluster.count});
+            }
+            ++proxies_;
+        }
+
+        // instances are only uploaded again when the near set changes
+        if (changed) {
+            for (auto& instances : near_) {
+                instances.clear();
+            }
+            for (auto i = 0u; i < clusters_.size(); ++i) {
+                if (!nearClusters_[i]) {
+                    continue;
+                }
+                for (const auto& [model, transform] : clusters_[i].instances) {
+                    near_[model].push_back(transform);
+                }
+            }
+            for (auto model = 0u; model < models_.size(); ++model) {
+                if (!near_[model].empty()) {
+                    models_[model].setPos(near_[model]);
+                }
+            }
+        }
+        for (auto model = 0u; model < models_.size(); ++model) {
+            if (!near_[model].empty()) {
+                models_[model].render(
+                    static_cast<unsigned>(near_[model].size()));
+            }
+        }
+        if (!ranges_.empty()) {
+            renderProxies();
+        }
+    }
+
+    [[nodiscard]] unsigned proxies() const noexcept {
+        return proxies_;
+    }
+};
+
+HLod::HLod(const HLodOptions& options) noexcept : pImpl_(options) {
+}
+
+HLod::HLod(HLod&& rhs) noexcept : pImpl_(std::move(rhs.pImpl_)) {
+}
+
+HLod::~HLod() noexcept {
+}
+
+void HLod::add(std::string_view filename,
+    const std::vector<glm::mat4>& instances,
+    const ModelOptions& options) noexcept {
+    pImpl_->add(filename, instances, options);
+}
+
+void HLod::build() noexcept {
+    pImpl_->build();
+}
+
+void HLod::render() const noexcept {
+    pImpl_->render();
+}
+
+unsigned HLod::proxies() const noexcept {
+    return pImpl_->proxies();
+}
+
+}  // namespace neat
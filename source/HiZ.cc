@@ -0,0 +1,183 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <utility>
+
+#include <GLES3/gl31.h>
+
+#include <GLState.hh>
+#include <HiZ.hh>
+#include <Log.hh>
+#include <Program.hh>
+
+namespace {
+
+// clang-format off
+const char* pyramidC = GLSL(
+
+precision highp float;
+precision highp sampler2D;
+
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (r32f, binding = 0) writeonly uniform highp image2D level;
+
+uniform sampler2D source;
+uniform int sourceLevel;
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(level);
+    if (any(greaterThanEqual(pos, size))) {
+        return;
+    }
+    if (sourceLevel < 0) {
+        imageStore(level, pos, vec4(texelFetch(source, pos, 0).r));
+        return;
+    }
+    ivec2 sourceSize = textureSize(source, sourceLevel);
+    ivec2 first = pos * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+    if (pos.x == size.x - 1) {
+        last.x = sourceSize.x - 1;
+    }
+    if (pos.y == size.y - 1) {
+        last.y = sourceSize.y - 1;
+    }
+    float depth = 0.;
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+        }
+    }
+    imageStore(level, pos, vec4(depth));
+}
+);
+// clang-format on
+
+struct PyramidShader {
+    neat::Program program = neat::Program({{GL_COMPUTE_SHADER, pyramidC}});
+    neat::Uniform<int> sourceLevel = program.uniform<int>("sourceLevel");
+};
+
+PyramidShader& pyramidShader() noexcept {
+    static PyramidShader shader;
+    return shader;
+}
+
+}  // namespace
+
+namespace neat {
+
+HiZ::HiZ(unsigned width, unsigned height) noexcept :
+    width_(width), height_(height) {
+    while ((std::max(width, height) >> levels_) != 0) {
+        ++levels_;
+    }
+
+    auto& state = GLState::instance();
+    glGenTextures(1, &depth_);
+    state.bindTexture(0, depth_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &pyramid_);
+    state.bindTexture(0, pyramid_);
+    glTexStorage2D(GL_TEXTURE_2D, levels_, GL_R32F, width, height);
+    glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    state.bindTexture(0, 0);
+
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGenFramebuffers(1, &id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, id_);
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_, 0);
+    GLenum none = GL_NONE;
+    glDrawBuffers(1, &none);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        Log() << "HiZ: depth framebuffer is incomplete";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+HiZ::HiZ(HiZ&& rhs) noexcept :
+    GLResource(std::move(rhs)),
+    depth_(std::exchange(rhs.depth_, 0)),
+    pyramid_(std::exchange(rhs.pyramid_, 0)),
+    width_(rhs.width_),
+    height_(rhs.height_),
+    levels_(rhs.levels_) {
+}
+
+HiZ::~HiZ() {
+    if (id_ != 0) {
+        glDeleteFramebuffers(1, &id_);
+    }
+    GLState::instance().deleteTexture(depth_);
+    GLState::instance().deleteTexture(pyramid_);
+    glDeleteTextures(1, &depth_);
+    glDeleteTextures(1, &pyramid_);
+}
+
+void HiZ::begin() noexcept {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer_);
+    glGetIntegerv(GL_VIEWPORT, viewport_);
+    glBindFramebuffer(GL_FRAMEBUFFER, id_);
+    glViewport(0, 0, width_, height_);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void HiZ::end() const noexcept {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(viewport_[0], viewport_[1], viewport_[2], viewport_[3]);
+
+    auto& state = GLState::instance();
+    auto& shader = pyramidShader();
+    shader.program.use();
+    for (auto level = 0u; level < levels_; ++level) {
+        state.bindTexture(0, level == 0 ? depth_ : pyramid_);
+        shader.sourceLevel.set(static_cast<int>(level) - 1);
+        glBindImageTexture(
+            0, pyramid_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        auto width = std::max(1u, width_ >> level);
+        auto height = std::max(1u, height_ >> level);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    state.bindTexture(0, 0);
+}
+
+unsigned int HiZ::getRawId() const noexcept {
+    return pyramid_;
+}
+
+unsigned HiZ::width() const noexcept {
+    return width_;
+}
+
+unsigned HiZ::height() const noexcept {
+    return height_;
+}
+
+unsigned HiZ::levels() const noexcept {
+    return levels_;
+}
+
+}  // namespace neat
@@ -0,0 +1,307 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <Jobs.hh>
+
+namespace neat {
+
+struct JobState {
+    std::function<void()> task;
+    Jobs::Affinity affinity = Jobs::Affinity::Any;
+    std::atomic<std::size_t> pending = 1;  // unfinished dependencies + 1
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    std::vector<std::shared_ptr<JobState>> next;
+};
+
+bool Job::done() const noexcept {
+    if (!state_) {
+        return true;
+    }
+    std::lock_guard lock(state_->mutex);
+    return state_->done;
+}
+
+namespace {
+
+/** scheduler and queue the current thread belongs to */
+struct Self {
+    const void* owner = nullptr;
+    std::size_t queue = 0;
+};
+
+thread_local Self self;
+
+}  // namespace
+
+class Jobs::Impl {
+    using State = std::shared_ptr<JobState>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<State> jobs;
+    };
+
+    // queue 0 takes jobs submitted from threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    Queue main_;
+    std::thread::id mainThread_;
+    std::mutex sleep_;
+    std::condition_variable wake_;
+    std::atomic<std::size_t> queued_ = 0;
+    std::atomic<bool> stop_ = false;
+
+    [[nodiscard]] std::size_t queue() const noexcept {
+        return self.owner == this ? self.queue : 0;
+    }
+
+    State take(std::size_t index, bool main) noexcept {
+        if (main) {
+            std::lock_guard lock(main_.mutex);
+            if (!main_.jobs.empty()) {
+                auto job = std::move(main_.jobs.front());
+                main_.jobs.pop_front();
+                return job;
+            }
+        }
+        for (std::size_t i = 0; i < queues_.size(); ++i) {
+            auto& queue = *queues_[(index + i) % queues_.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.jobs.empty()) {
+                continue;
+            }
+            State job;
+            // the owner works on its newest job, thieves take the oldest
+            if (i == 0) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            } else {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            --queued_;
+            return job;
+        }
+        return nullptr;
+    }
+
+    void run(const State& job) noexcept {
+        job->task();
+        decltype(job->next) next;
+        {
+            std::lock_guard lock(job->mutex);
+            job->done = true;
+            next.swap(job->next);
+        }
+        job->finished.notify_all();
+        for (const auto& state : next) {
+            release(state);
+        }
+    }
+
+    void work(std::size_t index) noexcept {
+        self = {this, index};
+        while (!stop_) {
+            if (auto job = take(index, false)) {
+                run(job);
+                continue;
+            }
+            std::unique_lock lock(sleep_);
+            wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        }
+    }
+
+  public:
+    explicit Impl(unsigned workers) : mainThread_(std::this_thread::get_id()) {
+        if (workers == 0) {
+            workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        }
+        for (auto i = 0u; i <= workers; ++i) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        for (auto i = 1u; i <= workers; ++i) {
+            threads_.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    ~Impl() noexcept {
+        {
+            std::lock_guard lock(sleep_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void schedule(State job) noexcept {
+        if (job->affinity == Affinity::Main) {
+            std::lock_guard lock(main_.mutex);
+            main_.jobs.push_back(std::move(job));
+            return;
+        }
+        {
+            auto& queue = *queues_[this->queue()];
+            std::lock_guard lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+            ++queued_;
+        }
+        // taking the lock orders this with a worker about to sleep
+        { std::lock_guard lock(sleep_); }
+        wake_.notify_one();
+    }
+
+    void release(const State& job) noexcept {
+        if (--job->pending == 0) {
+            schedule(job);
+        }
+    }
+
+    Job submit(std::function<void()> task, const std::vector<Job>& after,
+        Affinity affinity) {
+        Job job;
+        job.state_ = std::make_shared<JobState>();
+        job.state_->task = std::move(task);
+        job.state_->affinity = affinity;
+        for (const auto& dependency : after) {
+            if (!dependency.state_) {
+                continue;
+            }
+            std::lock_guard lock(dependency.state_->mutex);
+            if (!dependency.state_->done) {
+                ++job.state_->pending;
+                dependency.state_->next.push_back(job.state_);
+            }
+        }
+        release(job.state_);
+        return job;
+    }
+
+    void wait(const Job& job) noexcept {
+        const auto& state = job.state_;
+        if (!state) {
+            return;
+        }
+        auto main = std::this_thread::get_id() == mainThread_;
+        auto index = queue();
+        while (true) {
+            {
+                std::lock_guard lock(state->mutex);
+                if (state->done) {
+                    return;
+                }
+            }
+            if (auto other = take(index, main)) {
+                run(other);
+                continue;
+            }
+            // woken when the job finishes, or soon to look for work again
+            std::unique_lock lock(state->mutex);
+            state->finished.wait_for(lock, std::chrono::milliseconds(1),
+                [&state] { return state->done; });
+        }
+    }
+
+    void runMain() noexcept {
+        std::size_t count;
+        {
+            std::lock_guard lock(main_.mutex);
+            count = main_.jobs.size();
+        }
+        for (; count > 0; --count) {
+            State job;
+            {
+                std::lock_guard lock(main_.mutex);
+                if (main_.jobs.empty()) {
+                    return;
+                }
+                job = std::move(main_.jobs.front());
+                main_.jobs.pop_front();
+            }
+            run(job);
+        }
+    }
+
+    [[nodiscard]] unsigned workers() const noexcept {
+        return static_cast<unsigned>(threads_.size());
+    }
+};
+
+Jobs::Jobs(unsigned workers) : pImpl_(workers) {
+}
+
+Jobs::~Jobs() noexcept {
+}
+
+Jobs& Jobs::instance() {
+    static Jobs jobs;
+    return jobs;
+}
+
+Job Jobs::submit(std::function<void()> task, const std::vector<Job>& after,
+    Affinity affinity) {
+    return pImpl_->submit(std::move(task), after, affinity);
+}
+
+void Jobs::wait(const Job& job) noexcept {
+    pImpl_->wait(job);
+}
+
+void Jobs::runMain() noexcept {
+    pImpl_->runMain();
+}
+
+void Jobs::parallelFor(std::size_t count, std::size_t grain,
+    const std::function<void(std::size_t, std::size_t)>& func) {
+    grain = std::max<std::size_t>(grain, 1);
+    auto chunks =
+        std::min<std::size_t>(workers() + 1, (count + grain - 1) / grain);
+    if (chunks <= 1) {
+        if (count != 0) {
+            func(0, count);
+        }
+        return;
+    }
+
+    auto chunk = (count + chunks - 1) / chunks;
+    std::vector<Job> jobs;
+    jobs.reserve(chunks - 1);
+    for (auto begin = chunk; begin < count; begin += chunk) {
+        auto end = std::min(begin + chunk, count);
+        jobs.push_back(submit([&func, begin, end] { func(begin, end); }));
+    }
+    func(0, chunk);
+    for (const auto& job : jobs) {
+        wait(job);
+    }
+}
+
+unsigned Jobs::workers() const noexcept {
+    return pImpl_->workers();
+}
+
+}  // namespace neat
@@ -0,0 +1,90 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <NoCopy.hh>
+
+namespace neat {
+
+/** Bump allocator for data living until the next reset(); blocks are kept
+    across resets so a steady state allocates nothing. Not thread safe,
+    meant to be owned by one recording thread */
+class LinearAllocator : private NoCopy {
+    static constexpr std::size_t BlockSize = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    std::size_t block_ = 0;
+    std::size_t used_ = 0;
+
+  public:
+    LinearAllocator() = default;
+    LinearAllocator(LinearAllocator&& rhs) noexcept = default;
+
+    [[nodiscard]] void* allocate(std::size_t size, std::size_t align) {
+        for (; block_ < blocks_.size(); ++block_, used_ = 0) {
+            auto offset = (used_ + align - 1) & ~(align - 1);
+            if (offset + size <= blocks_[block_].size) {
+                used_ = offset + size;
+                return blocks_[block_].data.get() + offset;
+            }
+        }
+        // new[] aligns to at least alignof(std::max_align_t)
+        auto blockSize = std::max(BlockSize, size);
+        blocks_.push_back(
+            {std::make_unique<std::byte[]>(blockSize), blockSize});
+        block_ = blocks_.size() - 1;
+        used_ = size;
+        return blocks_.back().data.get();
+    }
+
+    /** copies of 'count' objects, which must be trivially copyable */
+    template <class T>
+    [[nodiscard]] T* copy(const T* source, std::size_t count) {
+        auto* result =
+            static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::uninitialized_copy(source, source + count, result);
+        return result;
+    }
+
+    /** frees everything allocated so far */
+    void reset() noexcept {
+        block_ = 0;
+        used_ = 0;
+    }
+
+    /** bytes reserved by all blocks */
+    [[nodiscard]] std::size_t capacity() const noexcept {
+        std::size_t result = 0;
+        for (const auto& block : blocks_) {
+            result += block.size;
+        }
+        return result;
+    }
+};
+
+}  // namespace neat
@@ -24,6 +24,8 @@
 #include <Texture.hh>
 #include <Program.hh>
 
+#include "UniformBlocks.hh"
+
 namespace neat {
 
 class Material : private NoCopy {
@@ -70,16 +72,35 @@ class Material : private NoCopy {
         specular_ = color;
     }
 
-    void bind(Program& program) const {
+    [[nodiscard]] bool textured() const noexcept {
+        return texture_.has_value();
+    }
+
+    [[nodiscard]] const glm::vec3& ambient() const noexcept {
+        return ambient_;
+    }
+
+    [[nodiscard]] const glm::vec3& diffuse() const noexcept {
+        return diffuse_;
+    }
+
+    void bind() const {
         if (texture_) {
             texture_->bind();
         }
-        glUniform3fv(
-            program.uniform("material.diffuse"), 1, glm::value_ptr(diffuse_));
-        glUniform3fv(
-            program.uniform("material.ambient"), 1, glm::value_ptr(ambient_));
-        glUniform3fv(
-            program.uniform("material.specular"), 1, glm::value_ptr(specular_));
+    }
+
+    /** GL name of the texture, 0 without one */
+    [[nodiscard]] unsigned int textureId() const noexcept {
+        return texture_ ? texture_->getRawId() : 0;
+    }
+
+    /** the uniform block of a model drawn with this material */
+    [[nodiscard]] MaterialBlock block(const glm::vec3& posOffset,
+        const glm::vec3& posScale) const noexcept {
+        return {glm::vec4(ambient_, 0.f), glm::vec4(diffuse_, 0.f),
+            glm::vec4(specular_, 0.f), glm::vec4(posOffset, 0.f),
+            glm::vec4(posScale, 0.f)};
     }
 
     static void unbind() {
@@ -16,40 +16,230 @@
 
 #pragma once
 
-#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <variant>
+#include <vector>
+
+#include <GLES3/gl32.h>
 
 #include <Buffer.hh>
+#include <RenderQueue.hh>
+
+#include "Bounds.hh"
+#include "Meshlet.hh"
 
 namespace neat {
 
+struct MeshData {
+    using Indices =
+        std::variant<std::vector<uint16_t>, std::vector<uint32_t>>;
+
+    Indices indices;
+    unsigned baseVertex = 0;
+    unsigned material = 0;
+    std::vector<Indices> lods;
+    Bounds bounds;
+    std::vector<Meshlet> meshlets;  // ranges of 'indices'
+
+    [[nodiscard]] std::size_t count(std::size_t lod = 0) const noexcept {
+        const auto& source = lod == 0 || lods.empty()
+                                 ? indices
+                                 : lods[std::min(lod, lods.size()) - 1];
+        return std::visit(
+            [](const auto& indices) { return indices.size(); }, source);
+    }
+
+    /** Appends triangles to 'meshes' using 16-bit indices, splitting them
+        into several meshes when the referenced vertex range is too wide.
+        A single triangle spanning more than 64k vertices keeps the whole
+        mesh 32-bit */
+    static void append(std::vector<MeshData>& meshes, const uint32_t* faces,
+        std::size_t count, unsigned baseVertex, unsigned material) {
+        constexpr uint32_t maxRange = std::numeric_limits<uint16_t>::max();
+        for (std::size_t i = 0; i < count; i += 3) {
+            auto [min, max] =
+                std::minmax({faces[i], faces[i + 1], faces[i + 2]});
+            if (max - min > maxRange) {
+                meshes.push_back({std::vector<uint32_t>(faces, faces + count),
+                    baseVertex, material, {}, {}, {}});
+                return;
+            }
+        }
+
+        auto flush = [&](std::size_t begin, std::size_t end, uint32_t min) {
+            std::vector<uint16_t> indices;
+            indices.reserve(end - begin);
+            for (auto i = begin; i < end; ++i) {
+                indices.push_back(static_cast<uint16_t>(faces[i] - min));
+            }
+            meshes.push_back(
+                {std::move(indices), baseVertex + min, material, {}, {}, {}});
+        };
+
+        std::size_t begin = 0;
+        auto min = std::numeric_limits<uint32_t>::max();
+        auto max = std::numeric_limits<uint32_t>::min();
+        for (std::size_t i = 0; i < count; i += 3) {
+            auto [faceMin, faceMax] =
+                std::minmax({faces[i], faces[i + 1], faces[i + 2]});
+            if (std::max(max, faceMax) - std::min(min, faceMin) > maxRange) {
+                flush(begin, i, min);
+                begin = i;
+                min = faceMin;
+                max = faceMax;
+            } else {
+                min = std::min(min, faceMin);
+                max = std::max(max, faceMax);
+            }
+        }
+        if (begin != count) {
+            flush(begin, count, min);
+        }
+    }
+};
+
 class Mesh : public Buffer {
-    unsigned count_;
+  public:
+    /** layout of glDrawElementsIndirect arguments */
+    struct DrawCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t reserved;
+    };
+
+  private:
+    struct Range {
+        std::size_t offset;
+        unsigned count;
+    };
+
+    std::vector<Range> lods_;
+    std::vector<Meshlet> meshlets_;
     unsigned materialIndex_;
+    unsigned type_;
+    int baseVertex_;
 
   public:
-    using Face = uint32_t;
-
-    Mesh(const Face* faces, unsigned count, unsigned matIndex) noexcept :
+    explicit Mesh(const MeshData& data) noexcept :
         Buffer(Buffer::Target::ElementArray),
-        count_(count),
-        materialIndex_(matIndex) {
+        meshlets_(data.meshlets),
+        materialIndex_(data.material),
+        type_(GL_UNSIGNED_INT),
+        baseVertex_(static_cast<int>(data.baseVertex)) {
         Buffer::bind();
-        Buffer::set(faces, count_ * sizeof(Face));
+        std::visit(
+            [this, &data](const auto& indices) {
+                using Indices = std::decay_t<decltype(indices)>;
+                if constexpr (sizeof(typename Indices::value_type) == 2) {
+                    type_ = GL_UNSIGNED_SHORT;
+                }
+                lods_.push_back({0, static_cast<unsigned>(indices.size())});
+                if (data.lods.empty()) {
+                    Buffer::set(indices);
+                    return;
+                }
+
+                Indices all(indices);
+                for (const auto& lod : data.lods) {
+                    const auto& lodIndices = std::get<Indices>(lod);
+                    lods_.push_back(
+                        {all.size() * sizeof(typename Indices::value_type),
+                            static_cast<unsigned>(lodIndices.size())});
+                    all.insert(all.end(), lodIndices.begin(), lodIndices.end());
+                }
+                Buffer::set(all);
+            },
+            data.indices);
     }
 
     Mesh(Mesh&& rhs) noexcept :
         Buffer(std::move(rhs)),
-        count_(rhs.count_),
-        materialIndex_(rhs.materialIndex_) {
+        lods_(std::move(rhs.lods_)),
+        meshlets_(std::move(rhs.meshlets_)),
+        materialIndex_(rhs.materialIndex_),
+        type_(rhs.type_),
+        baseVertex_(rhs.baseVertex_) {
     }
 
     [[nodiscard]] unsigned materialIndex() const noexcept {
         return materialIndex_;
     }
 
-    void render(unsigned instances) const noexcept {
-        glDrawElementsInstanced(
-            GL_TRIANGLES, count_, GL_UNSIGNED_INT, nullptr, instances);
+    [[nodiscard]] unsigned lods() const noexcept {
+        return lods_.size();
+    }
+
+    [[nodiscard]] const std::vector<Meshlet>& meshlets() const noexcept {
+        return meshlets_;
+    }
+
+    /** draws one instance of the given indices of the full detail mesh */
+    void render(const IndexRange& range) const noexcept {
+        auto indexSize = type_ == GL_UNSIGNED_SHORT ? 2u : 4u;
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, type_,
+            reinterpret_cast<const void*>(
+                static_cast<std::size_t>(range.first) * indexSize),
+            1, baseVertex_);
+    }
+
+    void render(unsigned instances, unsigned lod = 0) const noexcept {
+        const auto& range = lods_[std::min<std::size_t>(lod, lods_.size() - 1)];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, type_,
+            reinterpret_cast<const void*>(range.offset), instances,
+            baseVertex_);
+    }
+
+    /** arguments drawing 'lod' with no instances yet */
+    [[nodiscard]] DrawCommand command(unsigned lod) const noexcept {
+        const auto& range = lods_[std::min<std::size_t>(lod, lods_.size() - 1)];
+        auto indexSize = type_ == GL_UNSIGNED_SHORT ? 2u : 4u;
+        return {range.count, 0, static_cast<uint32_t>(range.offset / indexSize),
+            baseVertex_, 0};
+    }
+
+    /** arguments of render(range), for a RenderQueue */
+    [[nodiscard]] RenderCommand renderCommand(
+        const IndexRange& range) const noexcept {
+        auto indexSize = type_ == GL_UNSIGNED_SHORT ? 2u : 4u;
+        auto command = renderCommand(1);
+        command.count = range.count;
+        command.offset = static_cast<std::size_t>(range.first) * indexSize;
+        return command;
+    }
+
+    /** arguments of render(instances, lod), for a RenderQueue */
+    [[nodiscard]] RenderCommand renderCommand(
+        unsigned instances, unsigned lod = 0) const noexcept {
+        const auto& range = lods_[std::min<std::size_t>(lod, lods_.size() - 1)];
+        RenderCommand command;
+        command.indexBuffer = getRawId();
+        command.indexType = type_;
+        command.count = range.count;
+        command.offset = range.offset;
+        command.instances = instances;
+        command.baseVertex = baseVertex_;
+        return command;
+    }
+
+    /** arguments of renderIndirect(offset), for a RenderQueue */
+    [[nodiscard]] RenderCommand indirectCommand(
+        std::size_t offset) const noexcept {
+        RenderCommand command;
+        command.kind = RenderCommand::Kind::ElementsIndirect;
+        command.indexBuffer = getRawId();
+        command.indexType = type_;
+        command.offset = offset;
+        return command;
+    }
+
+    /** draws with the command at 'offset' of the bound indirect buffer */
+    void renderIndirect(std::size_t offset) const noexcept {
+        glDrawElementsIndirect(
+            GL_TRIANGLES, type_, reinterpret_cast<const void*>(offset));
     }
 };
 
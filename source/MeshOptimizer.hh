@@ -0,0 +1,371 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <Log.hh>
+
+#include "ModelData.hh"
+#include "Parallel.hh"
+
+namespace neat::optimizer {
+
+struct Triangles {
+    std::vector<uint32_t> indices;
+    unsigned material;
+};
+
+inline std::vector<uint32_t> expand(const MeshData& mesh) {
+    return std::visit(
+        [&mesh](const auto& indices) {
+            std::vector<uint32_t> result;
+            result.reserve(indices.size());
+            for (auto index : indices) {
+                result.push_back(index + mesh.baseVertex);
+            }
+            return result;
+        },
+        mesh.indices);
+}
+
+inline std::vector<Triangles> expand(const std::vector<MeshData>& meshes) {
+    std::vector<Triangles> result;
+    result.reserve(meshes.size());
+    for (const auto& mesh : meshes) {
+        result.push_back({expand(mesh), mesh.material});
+    }
+    return result;
+}
+
+/** Average cache miss ratio of a FIFO post-transform cache */
+inline float acmr(const std::vector<Triangles>& meshes, unsigned size = 16) {
+    std::size_t misses = 0;
+    std::size_t triangles = 0;
+    for (const auto& mesh : meshes) {
+        std::vector<uint32_t> cache(size, ~0u);
+        unsigned head = 0;
+        for (auto index : mesh.indices) {
+            if (std::find(cache.begin(), cache.end(), index) == cache.end()) {
+                cache[head] = index;
+                head = (head + 1) % size;
+                ++misses;
+            }
+        }
+        triangles += mesh.indices.size() / 3;
+    }
+    return triangles != 0 ? static_cast<float>(misses) / triangles : 0.f;
+}
+
+/** Merges bitwise identical vertices */
+inline void weld(ModelData& data, std::vector<Triangles>& meshes) {
+    struct Key {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texcoord;
+
+        bool operator==(const Key& rhs) const noexcept {
+            return std::memcmp(this, &rhs, sizeof(Key)) == 0;
+        }
+    };
+
+    struct Hash {
+        std::size_t operator()(const Key& key) const noexcept {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&key);
+            uint64_t hash = 0xcbf29ce484222325;
+            for (auto i = 0u; i < sizeof(Key); ++i) {
+                hash = (hash ^ bytes[i]) * 0x100000001b3;
+            }
+            return hash;
+        }
+    };
+
+    auto count = data.vertices.size();
+    auto hasTexcoords = data.texcoords.size() == count;
+    std::unordered_map<Key, uint32_t, Hash> unique(count);
+    std::vector<uint32_t> remap(count);
+    ModelData welded;
+    for (auto i = 0u; i < count; ++i) {
+        Key key{data.vertices[i], data.normals[i],
+            hasTexcoords ? data.texcoords[i] : glm::vec2(0.f)};
+        auto [found, inserted] =
+            unique.emplace(key, static_cast<uint32_t>(welded.vertices.size()));
+        if (inserted) {
+            welded.vertices.push_back(key.position);
+            welded.normals.push_back(key.normal);
+            if (hasTexcoords) {
+                welded.texcoords.push_back(key.texcoord);
+            }
+        }
+        remap[i] = found->second;
+    }
+
+    for (auto& mesh : meshes) {
+        for (auto& index : mesh.indices) {
+            index = remap[index];
+        }
+    }
+    data.vertices = std::move(welded.vertices);
+    data.normals = std::move(welded.normals);
+    data.texcoords = std::move(welded.texcoords);
+}
+
+/** Tom Forsyth's linear-speed vertex cache optimization */
+inline void optimizeVertexCache(std::vector<uint32_t>& indices) {
+    constexpr int cacheSize = 32;
+    constexpr std::size_t none = ~std::size_t{0};
+
+    std::vector<uint32_t> vertices(indices);
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()),
+        vertices.end());
+    auto vertexCount = vertices.size();
+    auto triangleCount = indices.size() / 3;
+
+    std::vector<uint32_t> local(indices.size());
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        local[i] = std::lower_bound(vertices.begin(), vertices.end(),
+                       indices[i]) -
+                   vertices.begin();
+        ++live[local[i]];
+    }
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < local.size(); ++i) {
+        adjacency[fill[local[i]]++] = i / 3;
+    }
+
+    std::vector<int> position(vertexCount, -1);
+    auto score = [&live, &position](uint32_t vertex) {
+        if (live[vertex] == 0) {
+            return -1.f;
+        }
+        auto result = 0.f;
+        if (auto pos = position[vertex]; pos >= 0) {
+            result = pos < 3 ? 0.75f
+                             : std::pow(1.f - static_cast<float>(pos - 3) /
+                                                  (cacheSize - 3),
+                                   1.5f);
+        }
+        return result + 2.f / std::sqrt(static_cast<float>(live[vertex]));
+    };
+
+    std::vector<float> vertexScore(vertexCount);
+    for (auto v = 0u; v < vertexCount; ++v) {
+        vertexScore[v] = score(v);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (std::size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = vertexScore[local[t * 3]] +
+                           vertexScore[local[t * 3 + 1]] +
+                           vertexScore[local[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    std::size_t cursor = 0;
+    auto best = static_cast<std::size_t>(
+        std::max_element(triangleScore.begin(), triangleScore.end()) -
+        triangleScore.begin());
+
+    while (result.size() < indices.size()) {
+        if (best == none) {
+            while (emitted[cursor]) {
+                ++cursor;
+            }
+            best = cursor;
+        }
+
+        emitted[best] = true;
+        nextCache.clear();
+        for (auto k = 0u; k < 3; ++k) {
+            auto v = local[best * 3 + k];
+            result.push_back(indices[best * 3 + k]);
+            nextCache.push_back(v);
+            auto* begin = adjacency.data() + offsets[v];
+            auto* end = begin + live[v];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            --live[v];
+        }
+        for (auto v : cache) {
+            if (std::find(nextCache.begin(), nextCache.begin() + 3, v) ==
+                nextCache.begin() + 3) {
+                nextCache.push_back(v);
+            }
+        }
+
+        for (std::size_t i = 0; i < nextCache.size(); ++i) {
+            position[nextCache[i]] = i < cacheSize ? static_cast<int>(i) : -1;
+        }
+        best = none;
+        auto bestScore = -1.f;
+        for (auto v : nextCache) {
+            auto delta = score(v) - vertexScore[v];
+            vertexScore[v] += delta;
+            for (auto i = offsets[v]; i < offsets[v] + live[v]; ++i) {
+                auto t = adjacency[i];
+                triangleScore[t] += delta;
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        nextCache.resize(std::min<std::size_t>(nextCache.size(), cacheSize));
+        std::swap(cache, nextCache);
+    }
+    indices = std::move(result);
+}
+
+/** Sorts clusters of the cache optimized triangle order so that outward
+    facing parts of the mesh are drawn first */
+inline void optimizeOverdraw(
+    std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions) {
+    constexpr unsigned cacheSize = 16;
+    constexpr std::size_t minCluster = 64 * 3;
+
+    struct Cluster {
+        std::size_t begin;
+        std::size_t end;
+        float sortKey;
+    };
+
+    std::vector<Cluster> clusters;
+    std::vector<uint32_t> cache(cacheSize, ~0u);
+    unsigned head = 0;
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i < indices.size(); i += 3) {
+        auto misses = 0u;
+        for (auto k = 0u; k < 3; ++k) {
+            if (std::find(cache.begin(), cache.end(), indices[i + k]) ==
+                cache.end()) {
+                cache[head] = indices[i + k];
+                head = (head + 1) % cacheSize;
+                ++misses;
+            }
+        }
+        if (misses == 3 && i - begin >= minCluster) {
+            clusters.push_back({begin, i, 0.f});
+            begin = i;
+        }
+    }
+    clusters.push_back({begin, indices.size(), 0.f});
+    if (clusters.size() == 1) {
+        return;
+    }
+
+    auto meshCenter = glm::vec3(0.f);
+    for (auto index : indices) {
+        meshCenter += positions[index];
+    }
+    meshCenter /= static_cast<float>(indices.size());
+
+    for (auto& cluster : clusters) {
+        auto center = glm::vec3(0.f);
+        auto normal = glm::vec3(0.f);
+        auto area = 0.f;
+        for (auto i = cluster.begin; i < cluster.end; i += 3) {
+            const auto& a = positions[indices[i]];
+            const auto& b = positions[indices[i + 1]];
+            const auto& c = positions[indices[i + 2]];
+            auto n = glm::cross(b - a, c - a);
+            auto triangleArea = glm::length(n);
+            center += (a + b + c) * (triangleArea / 3.f);
+            normal += n;
+            area += triangleArea;
+        }
+        if (area > 0.f && glm::length(normal) > 0.f) {
+            cluster.sortKey =
+                glm::dot(center / area - meshCenter, glm::normalize(normal));
+        }
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b) {
+            return a.sortKey > b.sortKey;
+        });
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const auto& cluster : clusters) {
+        result.insert(result.end(), indices.begin() + cluster.begin,
+            indices.begin() + cluster.end);
+    }
+    indices = std::move(result);
+}
+
+/** Renumbers vertices in the order of first use and drops unused ones */
+inline void optimizeVertexFetch(
+    ModelData& data, std::vector<Triangles>& meshes) {
+    auto hasTexcoords = data.texcoords.size() == data.vertices.size();
+    std::vector<uint32_t> remap(data.vertices.size(), ~0u);
+    ModelData ordered;
+    for (auto& mesh : meshes) {
+        for (auto& index : mesh.indices) {
+            if (remap[index] == ~0u) {
+                remap[index] = ordered.vertices.size();
+                ordered.vertices.push_back(data.vertices[index]);
+                ordered.normals.push_back(data.normals[index]);
+                if (hasTexcoords) {
+                    ordered.texcoords.push_back(data.texcoords[index]);
+                }
+            }
+            index = remap[index];
+        }
+    }
+    data.vertices = std::move(ordered.vertices);
+    data.normals = std::move(ordered.normals);
+    data.texcoords = std::move(ordered.texcoords);
+}
+
+}  // namespace neat::optimizer
+
+namespace neat {
+
+inline void optimizeModel(ModelData& data, std::string_view name) noexcept {
+    auto meshes = optimizer::expand(data.meshes);
+    auto before = optimizer::acmr(meshes);
+
+    optimizer::weld(data, meshes);
+    parallelFor(meshes.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            optimizer::optimizeVertexCache(meshes[i].indices);
+            optimizer::optimizeOverdraw(meshes[i].indices, data.vertices);
+        }
+    });
+    optimizer::optimizeVertexFetch(data, meshes);
+
+    data.meshes.clear();
+    for (const auto& mesh : meshes) {
+        MeshData::append(data.meshes, mesh.indices.data(), mesh.indices.size(),
+            0, mesh.material);
+    }
+    Log() << name << ": ACMR " << before << " -> " << optimizer::acmr(meshes);
+}
+
+}  // namespace neat
@@ -0,0 +1,221 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hh"
+#include "Culling.hh"
+
+namespace neat {
+
+/** Cluster of neighbouring triangles, culled as a whole. Its triangles
+    all face away from eye positions where
+    dot(center - eye, axis) >= cutoff * |center - eye| + radius */
+struct Meshlet {
+    uint32_t first;    // first index
+    uint32_t count;    // number of indices
+    glm::vec4 sphere;  // center, radius
+    glm::vec4 cone;    // axis, cutoff (1 never culls)
+
+    static constexpr unsigned maxVertices = 64;
+    static constexpr unsigned maxTriangles = 124;
+
+    [[nodiscard]] bool visible(
+        const Frustum& frustum, const glm::vec3& eye) const noexcept {
+        for (const auto& plane : frustum.planes) {
+            if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w <
+                -sphere.w) {
+                return false;
+            }
+        }
+        auto toCenter = glm::vec3(sphere) - eye;
+        return glm::dot(toCenter, glm::vec3(cone)) <
+               cone.w * glm::length(toCenter) + sphere.w;
+    }
+};
+
+/** Reorders 'indices' into meshlets grown greedily from a seed triangle,
+    preferring neighbours that add the fewest vertices and then those
+    facing the same way */
+template <class Index>
+std::vector<Meshlet> buildMeshlets(std::vector<Index>& indices,
+    const std::vector<glm::vec3>& vertices, unsigned baseVertex) {
+    auto triangles = indices.size() / 3;
+    auto position = [&](std::size_t index) {
+        return vertices[indices[index] + baseVertex];
+    };
+
+    std::size_t vertexCount = 0;
+    for (auto index : indices) {
+        vertexCount = std::max<std::size_t>(vertexCount, index + 1u);
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (auto index : indices) {
+        ++offsets[index + 1u];
+    }
+    for (std::size_t v = 1; v <= vertexCount; ++v) {
+        offsets[v] += offsets[v - 1];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    auto next = offsets;
+    std::vector<glm::vec3> normals(triangles);
+    for (std::size_t t = 0; t < triangles; ++t) {
+        for (auto k = 0u; k < 3; ++k) {
+            adjacency[next[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+        auto a = position(t * 3);
+        auto n = glm::cross(position(t * 3 + 1) - a, position(t * 3 + 2) - a);
+        auto length = glm::length(n);
+        normals[t] = length > 0.f ? n / length : glm::vec3(0.f);
+    }
+
+    std::vector<Meshlet> meshlets;
+    std::vector<Index> result;
+    result.reserve(indices.size());
+    std::vector<bool> used(triangles, false);
+    std::vector<uint32_t> stamp(vertexCount, ~0u);
+    std::vector<uint32_t> candidates;
+    std::size_t seed = 0;
+    while (true) {
+        while (seed < triangles && used[seed]) {
+            ++seed;
+        }
+        if (seed == triangles) {
+            break;
+        }
+
+        auto id = static_cast<uint32_t>(meshlets.size());
+        auto first = result.size();
+        auto vertexUsed = 0u;
+        auto axis = glm::vec3(0.f);
+        candidates.clear();
+        auto newVertices = [&](std::size_t t) {
+            auto count = 0u;
+            for (auto k = 0u; k < 3; ++k) {
+                count += stamp[indices[t * 3 + k]] != id;
+            }
+            return count;
+        };
+        auto add = [&](std::size_t t) {
+            used[t] = true;
+            axis += normals[t];
+            for (auto k = 0u; k < 3; ++k) {
+                auto v = indices[t * 3 + k];
+                result.push_back(v);
+                if (stamp[v] != id) {
+                    stamp[v] = id;
+                    ++vertexUsed;
+                    candidates.insert(candidates.end(),
+                        adjacency.begin() + offsets[v],
+                        adjacency.begin() + offsets[v + 1u]);
+                }
+            }
+        };
+
+        add(seed);
+        for (auto count = 1u; count < Meshlet::maxTriangles; ++count) {
+            candidates.erase(std::remove_if(candidates.begin(),
+                                 candidates.end(),
+                                 [&used](uint32_t t) { return used[t]; }),
+                candidates.end());
+            auto direction = glm::length(axis) > 0.f ? glm::normalize(axis)
+                                                     : glm::vec3(0.f);
+            auto best = ~0u;
+            auto bestVertices = 4u;
+            auto bestFacing = -2.f;
+            for (auto t : candidates) {
+                auto added = newVertices(t);
+                if (vertexUsed + added > Meshlet::maxVertices) {
+                    continue;
+                }
+                auto facing = glm::dot(normals[t], direction);
+                if (added < bestVertices ||
+                    (added == bestVertices && facing > bestFacing)) {
+                    best = t;
+                    bestVertices = added;
+                    bestFacing = facing;
+                }
+            }
+            if (best == ~0u) {
+                break;
+            }
+            add(best);
+        }
+
+        Meshlet meshlet{static_cast<uint32_t>(first),
+            static_cast<uint32_t>(result.size() - first), {}, {}};
+        meshlet.sphere =
+            Bounds::of(meshlet.count, [&](std::size_t i) {
+                return vertices[result[first + i] + baseVertex];
+            }).sphere;
+        auto length = glm::length(axis);
+        auto minDot = 1.f;
+        if (length > 0.f) {
+            axis /= length;
+            for (auto i = first; i < result.size(); i += 3) {
+                const auto& a = vertices[result[i] + baseVertex];
+                auto n = glm::cross(vertices[result[i + 1] + baseVertex] - a,
+                    vertices[result[i + 2] + baseVertex] - a);
+                if (auto l = glm::length(n); l > 0.f) {
+                    minDot = std::min(minDot, glm::dot(n / l, axis));
+                }
+            }
+        }
+        // cones wider than ~85 degrees are not worth testing
+        meshlet.cone = glm::vec4(axis,
+            length > 0.f && minDot > 0.1f ? std::sqrt(1.f - minDot * minDot)
+                                          : 1.f);
+        meshlets.push_back(meshlet);
+    }
+    indices = std::move(result);
+    return meshlets;
+}
+
+struct IndexRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+/** Visible meshlets as index ranges, merging adjacent ones, and their
+    number. The frustum and eye are in the space of the meshlets */
+inline unsigned cullMeshlets(const std::vector<Meshlet>& meshlets,
+    const Frustum& frustum, const glm::vec3& eye,
+    std::vector<IndexRange>& ranges) noexcept {
+    ranges.clear();
+    auto visible = 0u;
+    for (const auto& meshlet : meshlets) {
+        if (!meshlet.visible(frustum, eye)) {
+            continue;
+        }
+        ++visible;
+        if (!ranges.empty() &&
+            ranges.back().first + ranges.back().count == meshlet.first) {
+            ranges.back().count += meshlet.count;
+        } else {
+            ranges.push_back({meshlet.first, meshlet.count});
+        }
+    }
+    return visible;
+}
+
+}  // namespace neat
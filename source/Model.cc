@@ -14,8 +14,35 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <Asset.hh>
+#include <GLState.hh>
+#include <Log.hh>
 #include <Model.hh>
+#include <OcclusionBuffer.hh>
+#include <RenderQueue.hh>
+#include <SpatialIndex.hh>
+#include <Transform.hh>
+
+#include "Culling.hh"
+#include "Geometry.hh"
+#include "GpuCulling.hh"
+#include "MeshOptimizer.hh"
+#include "ModelCache.hh"
+#include "OcclusionQuery.hh"
+#include "Simplifier.hh"
+#include "TriangleBvh.hh"
+#include "UniformBlocks.hh"
+#include "VertexLayout.hh"
 
 #ifdef ENABLE_ASSIMP
 #include "assimp_loader.hh"
@@ -35,11 +62,18 @@ layout (location = 3) in ivec4 boneids;
 layout (location = 4) in vec4 weights;
 layout (location = 5) in mat4 model;
 
-const uint maxBones = 128u;
-
+layout (std140, binding = 0) uniform Camera {
+    highp mat4 view;
+    highp mat4 vp;
+};
 
-uniform mat4 view;
-uniform mat4 vp;
+layout (std140, binding = 2) uniform Material {
+    highp vec3 ambient;
+    highp vec3 diffuse;
+    highp vec3 specular;
+    highp vec3 posOffset;
+    highp vec3 posScale;
+} material;
 
 out vec2 uv;
 out vec4 vertPos;
@@ -47,10 +81,9 @@ out vec4 vertNorm;
 
 void main() {
     mat4 mv = view * model;
-    mat4 boneTrans = mat4(1.);
-    vec4 pos = boneTrans * vec4(position, 1.0);
+    vec4 pos = vec4(material.posOffset + material.posScale * position, 1.0);
     vertPos = mv * pos;
-    vertNorm = mv * (boneTrans * vec4(normal, 0.0));
+    vertNorm = mv * vec4(normal, 0.0);
     gl_Position = vp * model * pos;
     uv = texcoord;
 }
@@ -60,12 +93,6 @@ const char* modelF = GLSL(
 
 layout (location = 0) out vec4 color;
 
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 const uint maxLightCount = 16u;
 
 struct Sun {
@@ -79,11 +106,25 @@ struct PointLight {
     float attenuation;
 };
 
+layout (std140, binding = 0) uniform Camera {
+    highp mat4 view;
+    highp mat4 vp;
+};
+
+layout (std140, binding = 1) uniform Lights {
+    Sun sun;
+    PointLight lights[maxLightCount];
+};
+
+layout (std140, binding = 2) uniform Material {
+    highp vec3 ambient;
+    highp vec3 diffuse;
+    highp vec3 specular;
+    highp vec3 posOffset;
+    highp vec3 posScale;
+} material;
+
 uniform sampler2D matTex;
-uniform mat4 view;
-uniform Material material;
-uniform PointLight lights[maxLightCount];
-uniform Sun sun;
 
 in vec2 uv;
 in vec4 vertPos;
@@ -109,105 +150,537 @@ vec3 calculatePointLight(uint index) {
 
 void main() {
     vec3 vertColor = material.ambient;
-    if (sun.color != vec3(0.)) {
+    if (sunLit) {
         vertColor += calculateLight(vec4(sun.direction,1.), sun.color);
     }
-    for (uint light = 0u; light < maxLightCount; ++light) {
-        if (lights[light].color != vec3(0.)) {
-            vertColor += calculatePointLight(light);
-        } else {
-     	    break;
-	}
+    for (uint light = 0u; light < lightCount; ++light) {
+        vertColor += calculatePointLight(light);
+    }
+    color = vec4(vertColor, 1.0);
+    if (textured) {
+        color *= texture(matTex, uv);
     }
-    color = vec4(vertColor, 1.0) * texture(matTex, uv);
 }
 );
 
 // clang-format on
 
+/** bits of a model program variant: lit by the sun, textured material,
+    and the number of point lights above them */
+enum Variant : uint32_t { SunLit = 1, Textured = 2 };
+constexpr auto lightShift = 2u;
+
 }  // namespace
 
 namespace neat {
 
-Program& modelProgram() noexcept {
-    static auto program =
-        Program({{GL_FRAGMENT_SHADER, modelF}, {GL_VERTEX_SHADER, modelV}});
-    return program;
+static void processModel(ModelData& data, std::string_view filename,
+    const ModelOptions& options) noexcept {
+    if (options.optimize) {
+        optimizeModel(data, filename);
+    }
+    if (options.meshlets) {
+        for (auto& mesh : data.meshes) {
+            std::visit(
+                [&data, &mesh](auto& indices) {
+                    mesh.meshlets =
+                        buildMeshlets(indices, data.vertices, mesh.baseVertex);
+                },
+                mesh.indices);
+        }
+    }
+    if (!options.lodErrors.empty()) {
+        generateLods(data, options.lodErrors, filename);
+    }
+}
+
+ModelData prepareModel(
+    std::string_view filename, const ModelOptions& options) noexcept {
+    std::vector<uint8_t> source;
+    Asset asset(filename);
+    if (asset.read(source) == Asset::Error) {
+        Log() << "error: cannot open file " << filename;
+        return {};
+    }
+
+    std::optional<ModelCache> cache;
+    if (!options.cacheDirectory.empty() &&
+        (options.optimize || !options.lodErrors.empty() || options.meshlets)) {
+        auto settings = options.lodErrors;
+        settings.push_back(options.optimize ? 1.f : 0.f);
+        settings.push_back(options.meshlets ? 1.f : 0.f);
+        cache.emplace(options.cacheDirectory, filename, source, settings);
+    }
+
+    // a cached model only needs its materials parsed
+    ModelData data;
+    if (cache && cache->load(data)) {
+        data.materials = loadModel(filename, source, false).materials;
+    } else {
+        data = loadModel(filename, source);
+        if (!data.meshes.empty()) {
+            processModel(data, filename, options);
+            if (cache) {
+                cache->store(data);
+            }
+        }
+    }
+    computeBounds(data);
+    return data;
+}
+
+struct RetainedGeometry {
+    std::shared_ptr<const Geometry> geometry;
+    std::shared_ptr<const TriangleBvh> bvh;
+    std::shared_ptr<const Occluder> occluder;
+};
+
+/** Geometry is shared by the models loaded from the same file with the
+    same processing, for as long as one of them is alive */
+static RetainedGeometry retainGeometry(const ModelData& data,
+    std::string_view filename, const ModelOptions& options) noexcept {
+    struct Entry {
+        std::weak_ptr<const Geometry> geometry;
+        std::weak_ptr<const TriangleBvh> bvh;
+        std::weak_ptr<const Occluder> occluder;
+    };
+    static std::mutex mutex;
+    static std::unordered_map<std::string, Entry> cache;
+
+    std::lock_guard lock(mutex);
+    for (auto it = cache.begin(); it != cache.end();) {
+        it = it->second.geometry.expired() ? cache.erase(it) : std::next(it);
+    }
+
+    Entry* entry = nullptr;
+    if (!filename.empty()) {
+        auto key = std::string(filename) + '|' +
+                   std::to_string(options.quantizeGeometry) +
+                   std::to_string(options.optimize) +
+                   std::to_string(options.meshlets);
+        for (auto error : options.lodErrors) {
+            key += '|' + std::to_string(error);
+        }
+        entry = &cache[key];
+    }
+
+    RetainedGeometry result;
+    if (entry) {
+        result.geometry = entry->geometry.lock();
+        result.bvh = entry->bvh.lock();
+        result.occluder = entry->occluder.lock();
+    }
+    if (!result.geometry) {
+        result.geometry =
+            std::make_shared<const Geometry>(data, options.quantizeGeometry);
+    }
+    if (!result.bvh && options.pickable) {
+        result.bvh = std::make_shared<const TriangleBvh>(result.geometry);
+    }
+    if (!result.occluder && options.occluder) {
+        result.occluder = std::make_shared<const Occluder>(*result.geometry);
+    }
+    if (entry) {
+        entry->geometry = result.geometry;
+        entry->bvh = result.bvh ? result.bvh : entry->bvh;
+        entry->occluder = result.occluder ? result.occluder : entry->occluder;
+    }
+    return result;
+}
+
+/** constants the model shaders branch on */
+static std::string modelPrelude(uint32_t key) {
+    auto flag = [key](uint32_t bit) { return key & bit ? "true" : "false"; };
+    return std::string("const bool sunLit = ") + flag(SunLit) +
+           ";\nconst bool textured = " + flag(Textured) +
+           ";\nconst uint lightCount = " + std::to_string(key >> lightShift) +
+           "u;\n";
+}
+
+static ProgramVariants& modelPrograms() noexcept {
+    static ProgramVariants programs(
+        {{GL_FRAGMENT_SHADER, modelF}, {GL_VERTEX_SHADER, modelV}},
+        modelPrelude);
+    return programs;
+}
+
+/** builds the unlit variants draws fall back to */
+static void prepareFallbacks() noexcept {
+    auto& programs = modelPrograms();
+    programs.get(0);
+    programs.get(Textured);
+}
+
+/** starts building the variants the current lights call for, only once
+    they are drawn with: setting lights one by one builds the last ones */
+static void requestLighting() noexcept {
+    auto& programs = modelPrograms();
+    auto lighting = modelScene().lighting;
+    programs.request(lighting);
+    programs.request(lighting | Textured);
+}
+
+/** keeps the variant bits of the lights set so far */
+static void updateLighting() noexcept {
+    const auto& blocks = sceneBlocks();
+    modelScene().lighting =
+        (blocks.sunLit() ? SunLit : 0u) | blocks.lightCount() << lightShift;
+}
+
+Scene& modelScene() noexcept {
+    static Scene scene;
+    return scene;
+}
+
+/** guards modelScene().stats against models recorded by workers */
+static std::mutex& statsMutex() noexcept {
+    static std::mutex mutex;
+    return mutex;
 }
 
 class Model::Impl : private GLResource {
-    enum Type : unsigned {
-        Vertexes,
-        Normals,
-        TexCoords,
-        Bones,
-        Weights,
-        Model,
-        Count
+    enum Attrib : unsigned {
+        Position,
+        Normal,
+        TexCoord,
+        BoneIds,
+        BoneWeights,
+        Transform
     };
 
+    enum Type : unsigned { Vertices, Bones, Weights, Model, Count };
+
     class VAOBinder {
       public:
         explicit VAOBinder(unsigned id) noexcept {
-            glBindVertexArray(id);
+            GLState::instance().bindVertexArray(id);
         }
         ~VAOBinder() noexcept {
-            glBindVertexArray(0);
+            GLState::instance().bindVertexArray(0);
         }
     };
 
     std::array<Buffer, Type::Count> buffers_;
     std::vector<Mesh> meshes_;
     std::vector<Material> materials_;
+    Buffer materialBlocks_{Buffer::Target::Uniform};
+    VertexLayout layout_;
+    Bounds bounds_;
+    glm::vec4 sphere_;
+    std::vector<float> lodErrors_;
+    float lodScreenError_;
+    bool cull_;
+    bool meshlets_ = false;
+    mutable std::optional<GpuCulling> gpu_;
+    mutable std::optional<OcclusionQuery> query_;
+    std::shared_ptr<const Geometry> geometry_;
+    std::shared_ptr<const TriangleBvh> bvh_;
+    std::shared_ptr<const Occluder> occluder_;
+    mutable glm::vec3 boxMin_{0.f};
+    mutable glm::vec3 boxMax_{0.f};
+    mutable std::vector<glm::mat4> instances_;
+    mutable Spheres spheres_;
+    mutable std::vector<glm::mat4> sorted_;
+    mutable std::vector<uint32_t> visibleIds_;
+    mutable std::vector<unsigned> lods_;
+    mutable std::vector<unsigned> lodFirst_;
+    mutable std::vector<IndexRange> ranges_;
+    mutable bool uploaded_ = false;
+    mutable unsigned visible_ = 0;
+    mutable float depth_ = 0.f;
+
+    void bindInstances(std::size_t first) const noexcept {
+        buffers_[Type::Model].bind();
+        for (auto i = 0u; i < 4; ++i) {
+            glVertexAttribPointer(Attrib::Transform + i, 4, GL_FLOAT, GL_FALSE,
+                sizeof(glm::mat4),
+                reinterpret_cast<const void*>(
+                    sizeof(glm::mat4) * first + sizeof(glm::vec4) * i));
+        }
+    }
+
+    [[nodiscard]] unsigned selectLod(std::size_t instance) const noexcept {
+        const auto& scene = modelScene();
+        auto center = scene.view * glm::vec4(spheres_.x[instance],
+                                       spheres_.y[instance],
+                                       spheres_.z[instance], 1.f);
+        auto radius = spheres_.radius[instance];
+        auto distance = -center.z;
+        if (distance <= radius) {
+            return 0;
+        }
+        auto projected = radius * scene.projection[1][1] / distance;
+        for (auto lod = lodErrors_.size(); lod > 0; --lod) {
+            if (lodErrors_[lod - 1] * projected <= lodScreenError_) {
+                return lod;
+            }
+        }
+        return 0;
+    }
+
+    /** one block per material, blockStride apart */
+    void uploadMaterials() noexcept {
+        auto stride = blockStride(sizeof(MaterialBlock));
+        std::vector<std::byte> blocks(stride * materials_.size());
+        for (std::size_t i = 0; i < materials_.size(); ++i) {
+            auto block =
+                materials_[i].block(layout_.offset(), layout_.scale());
+            std::memcpy(blocks.data() + stride * i, &block, sizeof(block));
+        }
+        materialBlocks_.bind();
+        materialBlocks_.set(blocks);
+    }
+
+    [[nodiscard]] uint32_t variant(unsigned material) const noexcept {
+        return modelScene().lighting |
+               (materials_[material].textured() ? Textured : 0u);
+    }
+
+    /** uses the program variant of the material too */
+    void bindMaterial(unsigned index) const noexcept {
+        auto& programs = modelPrograms();
+        auto key = variant(index);
+        programs.get(programs.ready(key) ? key : key & Textured).use();
+        materials_[index].bind();
+        materialBlocks_.bindRange(Buffer::Target::Uniform,
+            static_cast<unsigned>(BlockBinding::Material),
+            blockStride(sizeof(MaterialBlock)) * index, sizeof(MaterialBlock));
+    }
+
+    /** records 'command' drawing 'mesh' with the instances from 'first'
+        on, without GL calls */
+    void record(RenderQueue::List& list, const Mesh& mesh,
+        RenderCommand command, unsigned first) const noexcept {
+        auto index = mesh.materialIndex();
+        const auto& programs = modelPrograms();
+        auto key = variant(index);
+        const auto* program = programs.find(key);
+        if (!program) {
+            program = programs.find(key & Textured);
+        }
+        if (!program) {
+            Log() << "Model: shader variant not compiled";
+            return;
+        }
+        command.program = program->getRawId();
+        command.vertexArray = id_;
+        command.instanceBuffer = buffers_[Type::Model].getRawId();
+        command.instanceAttrib = Attrib::Transform;
+        command.firstInstance = first;
+        command.texture = materials_[index].textureId();
+        command.blockBuffer = materialBlocks_.getRawId();
+        command.blockBinding = static_cast<unsigned>(BlockBinding::Material);
+        command.blockOffset = static_cast<uint32_t>(
+            blockStride(sizeof(MaterialBlock)) * index);
+        command.blockSize = sizeof(MaterialBlock);
+        list.add(RenderQueue::Pass::Opaque, depth_, command);
+    }
+
+    /** draws the first 'instances' in the order setPos gave them; the
+        buffer may hold the subset a culled render left in it */
+    void drawAll(unsigned instances, RenderQueue::List* list) const noexcept {
+        auto count = std::min<std::size_t>(instances, instances_.size());
+        if (list && count != 0) {
+            list->upload(buffers_[Model].getRawId(), instances_.data(),
+                sizeof(glm::mat4) * count);
+        } else if (!list && !uploaded_ && count != 0) {
+            buffers_[Model].bind();
+            buffers_[Model].set(instances_);
+            uploaded_ = true;
+        }
+        draw(0, instances, 0, list);
+    }
+
+    /** draws 'count' instances from 'first' on, which the instance
+        attributes already point at unless recording into 'list' */
+    void draw(unsigned first, unsigned count, unsigned lod,
+        RenderQueue::List* list) const noexcept {
+        for (const auto& mesh : meshes_) {
+            if (list) {
+                record(*list, mesh, mesh.renderCommand(count, lod), first);
+                continue;
+            }
+            bindMaterial(mesh.materialIndex());
+            mesh.bind();
+            mesh.render(count, lod);
+        }
+    }
+
+    /** draws instances [first, first + count) of sorted_ one by one,
+        skipping the meshlets each of them cannot show */
+    void drawMeshlets(unsigned first, unsigned count, RenderQueue::List* list,
+        RenderStats& stats) const noexcept {
+        const auto& scene = modelScene();
+        for (auto i = first; i < first + count; ++i) {
+            auto modelView = scene.view * sorted_[i];
+            auto frustum = Frustum::fromMatrix(scene.projection * modelView);
+            auto eye = glm::vec3(glm::inverse(modelView)[3]);
+            if (!list) {
+                bindInstances(i);
+            }
+            for (const auto& mesh : meshes_) {
+                if (!list) {
+                    bindMaterial(mesh.materialIndex());
+                    mesh.bind();
+                }
+                if (mesh.meshlets().empty()) {
+                    if (list) {
+                        record(*list, mesh, mesh.renderCommand(1), i);
+                    } else {
+                        mesh.render(1);
+                    }
+                    continue;
+                }
+                auto visible =
+                    cullMeshlets(mesh.meshlets(), frustum, eye, ranges_);
+                stats.meshlets +=
+                    static_cast<unsigned>(mesh.meshlets().size()) - visible;
+                for (const auto& range : ranges_) {
+                    if (list) {
+                        record(*list, mesh, mesh.renderCommand(range), i);
+                    } else {
+                        mesh.render(range);
+                    }
+                }
+            }
+        }
+    }
+
+    /** instance counts come from the culling pass, so the CPU cost does
+        not depend on how many instances there are */
+    void drawIndirect(
+        unsigned instances, RenderQueue::List* list) const noexcept {
+        if (list) {
+            for (auto lod = 0u; lod < gpu_->lods(); ++lod) {
+                for (auto i = 0u; i < meshes_.size(); ++i) {
+                    auto command =
+                        meshes_[i].indirectCommand(gpu_->commandOffset(lod, i));
+                    command.indirectBuffer = gpu_->commandBuffer();
+                    record(*list, meshes_[i], command, lod * instances);
+                }
+            }
+            return;
+        }
+        gpu_->bindCommands();
+        for (auto lod = 0u; lod < gpu_->lods(); ++lod) {
+            bindInstances(lod * instances);
+            for (auto i = 0u; i < meshes_.size(); ++i) {
+                bindMaterial(meshes_[i].materialIndex());
+                meshes_[i].bind();
+                meshes_[i].renderIndirect(gpu_->commandOffset(lod, i));
+            }
+        }
+        bindInstances(0);
+        Buffer::unbind(Buffer::Target::DrawIndirect);
+    }
+
+    /** view space distance of the nearest instance, orders queued draws */
+    [[nodiscard]] float nearest(unsigned instances) const noexcept {
+        const auto& view = modelScene().view;
+        auto center = glm::vec4(glm::vec3(sphere_), 1.f);
+        auto result = std::numeric_limits<float>::max();
+        auto count = std::min<std::size_t>(instances, instances_.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            auto viewCenter = view * (instances_[i] * center);
+            result = std::min(result, -viewCenter.z - sphere_.w);
+        }
+        return count != 0 ? result : 0.f;
+    }
+
+    /** world space box around every instance, for occlusion queries */
+    void updateBox() const noexcept {
+        boxMin_ = glm::vec3(std::numeric_limits<float>::max());
+        boxMax_ = -boxMin_;
+        for (const auto& pos : instances_) {
+            for (auto i = 0u; i < 8; ++i) {
+                auto corner = glm::vec3(i & 1 ? bounds_.max.x : bounds_.min.x,
+                    i & 2 ? bounds_.max.y : bounds_.min.y,
+                    i & 4 ? bounds_.max.z : bounds_.min.z);
+                auto world = glm::vec3(pos * glm::vec4(corner, 1.f));
+                boxMin_ = glm::min(boxMin_, world);
+                boxMax_ = glm::max(boxMax_, world);
+            }
+        }
+    }
 
   public:
-    explicit Impl(ModelData&& data) noexcept :
-        meshes_(std::move(data.meshes)), materials_(std::move(data.materials)) {
+    Impl(ModelData&& data, const ModelOptions& options,
+        std::string_view filename = {}) noexcept :
+        materials_(std::move(data.materials)),
+        layout_(options.format),
+        bounds_(data.bounds),
+        sphere_(data.bounds.sphere),
+        lodErrors_(options.lodErrors),
+        lodScreenError_(options.lodScreenError),
+        cull_(options.cull) {
+        meshes_.reserve(data.meshes.size());
+        for (const auto& mesh : data.meshes) {
+            meshes_.emplace_back(mesh);
+            meshlets_ = meshlets_ || !mesh.meshlets.empty();
+        }
+        if (options.gpuCulling) {
+            gpu_.emplace(meshes_);
+        }
+        if (options.occlusionQuery) {
+            query_.emplace();
+        }
+        if (options.retainGeometry || options.pickable || options.occluder) {
+            auto retained = retainGeometry(data, filename, options);
+            geometry_ = std::move(retained.geometry);
+            bvh_ = std::move(retained.bvh);
+            occluder_ = std::move(retained.occluder);
+        }
         buffers_[Model] = Buffer(Buffer::Target::Array, true);
         glGenVertexArrays(1, &id_);
+        // before any worker records or any shader reads the blocks
+        prepareFallbacks();
 
         VAOBinder bind(id_);
-        glEnableVertexAttribArray(Type::Vertexes);
-        buffers_[Type::Vertexes].bind();
-        buffers_[Type::Vertexes].set(data.vertices);
-        glVertexAttribPointer(
-            Type::Vertexes, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-        glEnableVertexAttribArray(Type::Normals);
-        buffers_[Type::Normals].bind();
-        buffers_[Type::Normals].set(data.normals);
-        glVertexAttribPointer(Type::Normals, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        buffers_[Type::Vertices].bind();
+        buffers_[Type::Vertices].set(layout_.pack(data));
+        layout_.setup(Attrib::Position, Attrib::Normal, Attrib::TexCoord);
+        // after pack, which quantizes the positions
+        uploadMaterials();
 
-        glEnableVertexAttribArray(Type::TexCoords);
-        buffers_[Type::TexCoords].bind();
-        buffers_[Type::TexCoords].set(data.texcoords);
-        glVertexAttribPointer(
-            Type::TexCoords, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-        glEnableVertexAttribArray(Type::Bones);
+        glEnableVertexAttribArray(Attrib::BoneIds);
         buffers_[Type::Bones].bind();
-        glVertexAttribPointer(Type::Bones, 4, GL_INT, GL_FALSE, 0, nullptr);
+        glVertexAttribPointer(Attrib::BoneIds, 4, GL_INT, GL_FALSE, 0, nullptr);
 
-        glEnableVertexAttribArray(Type::Weights);
+        glEnableVertexAttribArray(Attrib::BoneWeights);
         buffers_[Type::Weights].bind();
-        glVertexAttribPointer(Type::Weights, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glVertexAttribPointer(
+            Attrib::BoneWeights, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-        buffers_[Type::Model].bind();
+        bindInstances(0);
         for (auto i = 0u; i < 4; ++i) {
-            glEnableVertexAttribArray(Type::Model + i);
-            glVertexAttribPointer(Type::Model + i, 4, GL_FLOAT, GL_FALSE,
-                sizeof(glm::mat4),
-                reinterpret_cast<const void*>(sizeof(glm::vec4) * i));
-            glVertexAttribDivisor(Type::Model + i, 1);
+            glEnableVertexAttribArray(Attrib::Transform + i);
+            glVertexAttribDivisor(Attrib::Transform + i, 1);
         }
-        glBindVertexArray(0);
     }
 
     Impl(Impl&& rhs) noexcept :
         GLResource(std::move(rhs)),
         buffers_(std::move(rhs.buffers_)),
         meshes_(std::move(rhs.meshes_)),
-        materials_(std::move(rhs.materials_)) {
+        materials_(std::move(rhs.materials_)),
+        materialBlocks_(std::move(rhs.materialBlocks_)),
+        layout_(rhs.layout_),
+        bounds_(rhs.bounds_),
+        sphere_(rhs.sphere_),
+        lodErrors_(std::move(rhs.lodErrors_)),
+        lodScreenError_(rhs.lodScreenError_),
+        cull_(rhs.cull_),
+        meshlets_(rhs.meshlets_),
+        gpu_(std::move(rhs.gpu_)),
+        query_(std::move(rhs.query_)),
+        geometry_(std::move(rhs.geometry_)),
+        bvh_(std::move(rhs.bvh_)),
+        occluder_(std::move(rhs.occluder_)),
+        boxMin_(rhs.boxMin_),
+        boxMax_(rhs.boxMax_),
+        instances_(std::move(rhs.instances_)),
+        spheres_(std::move(rhs.spheres_)),
+        uploaded_(rhs.uploaded_) {
     }
 
     [[nodiscard]] bool valid() const noexcept {
@@ -215,33 +688,219 @@ class Model::Impl : private GLResource {
     }
 
     void setPos(const glm::mat4& pos) const noexcept {
-        buffers_[Model].bind();
-        buffers_[Model].set(glm::value_ptr(pos), sizeof(glm::mat4));
+        setPos(std::vector<glm::mat4>{pos});
     }
 
     void setPos(const std::vector<glm::mat4>& pos) const noexcept {
+        instances_ = pos;
+        placeInstances();
+    }
+
+    void setPos(const glm::mat4& parent,
+        const std::vector<glm::mat4>& local) const noexcept {
+        instances_.resize(local.size());
+        transform::multiply(
+            parent, local.data(), instances_.data(), local.size());
+        placeInstances();
+    }
+
+    /** updates bounds and uploads instances_ after they changed */
+    void placeInstances() const noexcept {
+        if (query_) {
+            updateBox();
+            query_->invalidate();
+        }
+        if (gpu_) {
+            gpu_->setInstances(instances_, buffers_[Model]);
+            return;
+        }
+        spheres_.resize(instances_.size());
+        for (std::size_t i = 0; i < instances_.size(); ++i) {
+            spheres_.set(i, transformSphere(sphere_, instances_[i]));
+        }
         buffers_[Model].bind();
-        buffers_[Model].set(pos);
+        buffers_[Model].set(instances_);
+        uploaded_ = true;
     }
 
-    void render(unsigned instances) const noexcept {
-        VAOBinder bind(id_);
-        auto& program = modelProgram();
-        program.use();
+    /** recording into 'list' makes no GL call and may happen on any
+        thread, unless the model uses GPU culling or occlusion queries */
+    void render(unsigned instances, RenderQueue::List* list) const noexcept {
+        RenderStats stats;
+        render(instances, list, stats);
+        std::lock_guard lock(statsMutex());
+        auto& total = modelScene().stats;
+        total.draws += stats.draws;
+        total.culled += stats.culled;
+        total.occluded += stats.occluded;
+        total.meshlets += stats.meshlets;
+        total.queries += stats.queries;
+    }
 
-        for (const auto& mesh : meshes_) {
-            materials_[mesh.materialIndex()].bind(program);
-            mesh.bind();
-            mesh.render(instances);
+    void render(unsigned instances, RenderQueue::List* list,
+        RenderStats& stats) const noexcept {
+        if (query_ && !query_->test(boxMin_, boxMax_, stats)) {
+            ++stats.culled;
+            visible_ = 0;
+            return;
+        }
+        ++stats.draws;
+
+        auto indirect = gpu_ && instances <= instances_.size();
+        if (indirect) {
+            gpu_->dispatch(buffers_[Model], instances, sphere_, lodErrors_,
+                lodScreenError_);
+        }
+
+        // recording leaves every GL call to RenderQueue::submit
+        std::optional<VAOBinder> bind;
+        if (list) {
+            depth_ = nearest(instances);
+        } else {
+            GLState::instance().enable(GL_BLEND, false);
+            bind.emplace(id_);
+        }
+
+        visible_ = instances;
+        if (indirect) {
+            drawIndirect(instances, list);
+            return;
+        }
+        const auto& scene = modelScene();
+        if ((lodErrors_.empty() && !cull_ && !scene.occlusion &&
+                !meshlets_) ||
+            instances > instances_.size()) {
+            drawAll(instances, list);
+            return;
+        }
+
+        visibleIds_.resize(instances);
+        if (cull_) {
+            visible_ = static_cast<unsigned>(
+                cull(Frustum::fromMatrix(scene.projection * scene.view),
+                    spheres_, instances, visibleIds_.data()));
+        } else {
+            std::iota(visibleIds_.begin(), visibleIds_.end(), 0u);
+        }
+        if (scene.occlusion) {
+            auto end = std::remove_if(visibleIds_.begin(),
+                visibleIds_.begin() + visible_, [this, &scene](uint32_t i) {
+                    return !scene.occlusion->visible(
+                        bounds_.min, bounds_.max, instances_[i]);
+                });
+            auto count = static_cast<unsigned>(end - visibleIds_.begin());
+            stats.occluded += visible_ - count;
+            visible_ = count;
+        }
+        // a recording uploads its instances even when the buffer holds
+        // them, another one of the frame may replace it before submit
+        if (lodErrors_.empty() && visible_ == instances && uploaded_ &&
+            !meshlets_ && !list) {
+            draw(0, instances, 0, list);
+            return;
+        }
+
+        lods_.assign(visible_, 0);
+        lodFirst_.assign(lodErrors_.size() + 2, 0);
+        for (auto i = 0u; i < visible_; ++i) {
+            if (!lodErrors_.empty()) {
+                lods_[i] = selectLod(visibleIds_[i]);
+            }
+            ++lodFirst_[lods_[i] + 1];
+        }
+        for (auto lod = 1u; lod < lodFirst_.size(); ++lod) {
+            lodFirst_[lod] += lodFirst_[lod - 1];
+        }
+        // moves the first instance of every LOD to the first of the next
+        sorted_.resize(visible_);
+        for (auto i = 0u; i < visible_; ++i) {
+            sorted_[lodFirst_[lods_[i]]++] = instances_[visibleIds_[i]];
+        }
+
+        if (list) {
+            list->upload(buffers_[Model].getRawId(), sorted_.data(),
+                sizeof(glm::mat4) * sorted_.size());
+        } else {
+            buffers_[Model].bind();
+            buffers_[Model].set(sorted_);
+        }
+        uploaded_ = false;
+        for (auto lod = 0u; lod + 1 < lodFirst_.size(); ++lod) {
+            auto first = lod == 0 ? 0u : lodFirst_[lod - 1];
+            auto count = lodFirst_[lod] - first;
+            if (count != 0 && lod == 0 && meshlets_) {
+                drawMeshlets(first, count, list, stats);
+            } else if (count != 0) {
+                if (!list) {
+                    bindInstances(first);
+                }
+                draw(first, count, lod, list);
+            }
+        }
+        if (!list) {
+            bindInstances(0);
+        }
+    }
+
+    [[nodiscard]] unsigned visible() const noexcept {
+        return visible_;
+    }
+
+    [[nodiscard]] Box bounds(unsigned instance) const noexcept {
+        if (instance >= instances_.size()) {
+            return {};
+        }
+        Box box{glm::vec3(std::numeric_limits<float>::max()),
+            glm::vec3(-std::numeric_limits<float>::max())};
+        for (auto i = 0u; i < 8; ++i) {
+            auto corner = glm::vec3(i & 1 ? bounds_.max.x : bounds_.min.x,
+                i & 2 ? bounds_.max.y : bounds_.min.y,
+                i & 4 ? bounds_.max.z : bounds_.min.z);
+            auto world =
+                glm::vec3(instances_[instance] * glm::vec4(corner, 1.f));
+            box.min = glm::min(box.min, world);
+            box.max = glm::max(box.max, world);
+        }
+        return box;
+    }
+
+    [[nodiscard]] std::optional<float> intersect(const glm::vec3& origin,
+        const glm::vec3& direction, unsigned instance) const noexcept {
+        if (!bvh_) {
+            Log() << "Model: not pickable, see ModelOptions";
+            return std::nullopt;
+        }
+        if (instance >= instances_.size()) {
+            return std::nullopt;
+        }
+        // distances along the ray survive the affine transform
+        auto toModel = glm::inverse(instances_[instance]);
+        return bvh_->intersect(glm::vec3(toModel * glm::vec4(origin, 1.f)),
+            glm::vec3(toModel * glm::vec4(direction, 0.f)));
+    }
+
+    void renderOccluder(OcclusionBuffer& buffer) const noexcept {
+        if (!occluder_) {
+            Log() << "Model: no occluder geometry, see ModelOptions";
+            return;
+        }
+        for (const auto& pos : instances_) {
+            buffer.add(occluder_->vertices, occluder_->indices, pos);
         }
     }
 
     ~Impl() noexcept {
+        GLState::instance().deleteVertexArray(id_);
         glDeleteVertexArrays(1, &id_);
     }
 };
 
-Model::Model(std::string_view filename) noexcept : pImpl_(loadModel(filename)) {
+Model::Model(std::string_view filename, const ModelOptions& options) noexcept :
+    pImpl_(prepareModel(filename, options), options, filename) {
+}
+
+Model::Model(ModelData&& data, const ModelOptions& options) noexcept :
+    pImpl_(std::move(data), options) {
 }
 
 Model::Model(Model&& rhs) noexcept : pImpl_(std::move(rhs.pImpl_)) {
@@ -251,13 +910,35 @@ Model::~Model() noexcept {
 }
 
 void Model::render(unsigned instances) const noexcept {
-    pImpl_->render(instances);
+    pImpl_->render(instances, nullptr);
+}
+
+void Model::render(
+    RenderQueue::List& list, unsigned instances) const noexcept {
+    pImpl_->render(instances, &list);
 }
 
 bool Model::valid() const noexcept {
     return pImpl_->valid();
 }
 
+unsigned Model::visible() const noexcept {
+    return pImpl_->visible();
+}
+
+Box Model::bounds(unsigned instance) const noexcept {
+    return pImpl_->bounds(instance);
+}
+
+std::optional<float> Model::intersect(const glm::vec3& origin,
+    const glm::vec3& direction, unsigned instance) const noexcept {
+    return pImpl_->intersect(origin, direction, instance);
+}
+
+void Model::renderOccluder(OcclusionBuffer& buffer) const noexcept {
+    pImpl_->renderOccluder(buffer);
+}
+
 void Model::setPos(const glm::mat4& pos) const noexcept {
     pImpl_->setPos(pos);
 }
@@ -266,33 +947,59 @@ void Model::setPos(const std::vector<glm::mat4>& pos) const noexcept {
     pImpl_->setPos(pos);
 }
 
+void Model::setPos(const glm::mat4& parent,
+    const std::vector<glm::mat4>& local) const noexcept {
+    pImpl_->setPos(parent, local);
+}
+
 void Model::setLight(unsigned index, const glm::vec3& position,
     const glm::vec3& color, float attenuation) noexcept {
-    auto& program = modelProgram();
-    auto pos = std::string("lights[") + std::to_string(index) + "].";
-    auto col = pos + "color";
-    auto att = pos + "attenuation";
-    pos += "position";
-    program.use();
-    glUniform3fv(program.uniform(pos.c_str()), 1, glm::value_ptr(position));
-    glUniform3fv(program.uniform(col.c_str()), 1, glm::value_ptr(color));
-    glUniform1f(program.uniform(att.c_str()), attenuation);
+    sceneBlocks().setLight(index, position, color, attenuation);
+    updateLighting();
 }
 
 void Model::setSun(
     const glm::vec3& direction, const glm::vec3& color) noexcept {
-    auto& program = modelProgram();
-    program.use();
-    glUniform3fv(
-        program.uniform("sun.direction"), 1, glm::value_ptr(direction));
-    glUniform3fv(program.uniform("sun.color"), 1, glm::value_ptr(color));
+    auto& scene = modelScene();
+    scene.sunDirection = direction;
+    scene.sunColor = color;
+    sceneBlocks().setSun(direction, color);
+    updateLighting();
+}
+
+void Model::setHiZ(const HiZ* hiZ) noexcept {
+    modelScene().hiZ = hiZ;
+}
+
+void Model::setOcclusion(const OcclusionBuffer* buffer) noexcept {
+    modelScene().occlusion = buffer;
+}
+
+void Model::finishShaders() noexcept {
+    requestLighting();
+    modelPrograms().finish();
+}
+
+void Model::pollShaders() noexcept {
+    // variants built since the last poll become usable by workers
+    requestLighting();
+    modelPrograms().poll();
+}
+
+RenderStats Model::stats() noexcept {
+    std::lock_guard lock(statsMutex());
+    auto& stats = modelScene().stats;
+    auto result = stats;
+    stats = {};
+    return result;
 }
 
 void Model::setVP(const glm::mat4& v, const glm::mat4& p) noexcept {
-    auto& program = modelProgram();
-    program.use();
-    glUniformMatrix4fv(program.uniform("view"), 1, false, glm::value_ptr(v));
-    glUniformMatrix4fv(program.uniform("vp"), 1, false, glm::value_ptr(p * v));
+    auto& scene = modelScene();
+    scene.view = v;
+    scene.projection = p;
+    sceneBlocks().setCamera(v, p * v);
+    pollShaders();
 }
 
 }  // namespace neat
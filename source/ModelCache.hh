@@ -0,0 +1,208 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <Log.hh>
+
+#include "ModelData.hh"
+
+namespace neat {
+
+/** Stores optimized model geometry, one file per source file and
+    processing, valid while the source contents are unchanged */
+class ModelCache {
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t vertices;
+        uint32_t texcoords;
+        uint32_t meshes;
+    };
+
+    struct MeshHeader {
+        uint32_t material;
+        uint32_t baseVertex;
+        uint32_t indexSize;
+        uint32_t lods;
+        uint32_t meshlets;
+    };
+#pragma pack(pop)
+
+    enum : uint32_t { Magic = 0x4e45544d, Version = 3 };
+
+    std::filesystem::path path_;
+    uint64_t key_ = 0;
+
+    static uint64_t hash(const void* data, std::size_t size,
+        uint64_t result = 0xcbf29ce484222325) noexcept {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            result = (result ^ bytes[i]) * 0x100000001b3;
+        }
+        return result;
+    }
+
+    template <class T>
+    static bool read(std::ifstream& file, std::vector<T>& data, uint32_t size,
+        std::streamoff end) {
+        auto left = end - static_cast<std::streamoff>(file.tellg());
+        if (static_cast<std::streamoff>(size * sizeof(T)) > left) {
+            return false;
+        }
+        data.resize(size);
+        return static_cast<bool>(
+            file.read(reinterpret_cast<char*>(data.data()), size * sizeof(T)));
+    }
+
+    template <class T>
+    static void write(std::ofstream& file, const std::vector<T>& data) {
+        file.write(reinterpret_cast<const char*>(data.data()),
+            data.size() * sizeof(T));
+    }
+
+  public:
+    /** 'source' is the contents of 'filename', 'settings' identifies the
+        processing applied to the geometry */
+    ModelCache(std::string_view directory, std::string_view filename,
+        const std::vector<uint8_t>& source,
+        const std::vector<float>& settings) noexcept {
+        auto settingsHash =
+            hash(settings.data(), settings.size() * sizeof(float));
+        key_ = hash(source.data(), source.size(), settingsHash);
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0')
+             << hash(filename.data(), filename.size(), settingsHash)
+             << ".mesh";
+        path_ = std::filesystem::path(directory) / name.str();
+    }
+
+    bool load(ModelData& data) const noexcept {
+        std::ifstream file(path_, std::ios::binary | std::ios::ate);
+        auto end = static_cast<std::streamoff>(file.tellg());
+        file.seekg(0);
+        Header header;  // NOLINT(hicpp-member-init)
+        if (!file ||
+            !file.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+            header.magic != Magic || header.version != Version ||
+            header.key != key_) {
+            return false;
+        }
+
+        ModelData cached;
+        if (!read(file, cached.vertices, header.vertices, end) ||
+            !read(file, cached.normals, header.vertices, end) ||
+            !read(file, cached.texcoords, header.texcoords, end)) {
+            return false;
+        }
+        for (auto i = 0u; i < header.meshes; ++i) {
+            MeshHeader mesh;  // NOLINT(hicpp-member-init)
+            if (!file.read(reinterpret_cast<char*>(&mesh), sizeof(mesh)) ||
+                static_cast<std::streamoff>(mesh.lods * sizeof(uint32_t)) >
+                    end - static_cast<std::streamoff>(file.tellg())) {
+                return false;
+            }
+            auto& meshData = cached.meshes.emplace_back();
+            meshData.material = mesh.material;
+            meshData.baseVertex = mesh.baseVertex;
+            meshData.lods.resize(mesh.lods);
+            auto readIndices = [&file, &mesh, end](
+                                   MeshData::Indices& indices) {
+                uint32_t count;
+                auto* bytes = reinterpret_cast<char*>(&count);
+                if (!file.read(bytes, sizeof(count))) {
+                    return false;
+                }
+                return mesh.indexSize == sizeof(uint16_t)
+                           ? read(file,
+                                 indices.emplace<std::vector<uint16_t>>(),
+                                 count, end)
+                           : read(file,
+                                 indices.emplace<std::vector<uint32_t>>(),
+                                 count, end);
+            };
+            if (!readIndices(meshData.indices)) {
+                return false;
+            }
+            for (auto& lod : meshData.lods) {
+                if (!readIndices(lod)) {
+                    return false;
+                }
+            }
+            if (!read(file, meshData.meshlets, mesh.meshlets, end)) {
+                return false;
+            }
+        }
+
+        data.vertices = std::move(cached.vertices);
+        data.normals = std::move(cached.normals);
+        data.texcoords = std::move(cached.texcoords);
+        data.meshes = std::move(cached.meshes);
+        return true;
+    }
+
+    void store(const ModelData& data) const noexcept {
+        std::error_code error;
+        std::filesystem::create_directories(path_.parent_path(), error);
+        std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            Log() << "error: cannot write cache " << path_.string();
+            return;
+        }
+
+        Header header{Magic, Version, key_,
+            static_cast<uint32_t>(data.vertices.size()),
+            static_cast<uint32_t>(data.texcoords.size()),
+            static_cast<uint32_t>(data.meshes.size())};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write(file, data.vertices);
+        write(file, data.normals);
+        write(file, data.texcoords);
+        for (const auto& mesh : data.meshes) {
+            std::visit(
+                [&file, &mesh](const auto& indices) {
+                    using Indices = std::decay_t<decltype(indices)>;
+                    MeshHeader meshHeader{mesh.material, mesh.baseVertex,
+                        sizeof(typename Indices::value_type),
+                        static_cast<uint32_t>(mesh.lods.size()),
+                        static_cast<uint32_t>(mesh.meshlets.size())};
+                    file.write(reinterpret_cast<const char*>(&meshHeader),
+                        sizeof(meshHeader));
+                    auto writeIndices = [&file](const Indices& data) {
+                        auto count = static_cast<uint32_t>(data.size());
+                        auto* bytes = reinterpret_cast<const char*>(&count);
+                        file.write(bytes, sizeof(count));
+                        write(file, data);
+                    };
+                    writeIndices(indices);
+                    for (const auto& lod : mesh.lods) {
+                        writeIndices(std::get<Indices>(lod));
+                    }
+                    write(file, mesh.meshlets);
+                },
+                mesh.indices);
+        }
+    }
+};
+
+}  // namespace neat
@@ -16,17 +16,59 @@
 
 #pragma once
 
+#include <Model.hh>
+
 #include "Material.hh"
 #include "Mesh.hh"
 
 namespace neat {
 
+class HiZ;
+
 struct ModelData {
     std::vector<Material> materials;
-    std::vector<Mesh> meshes;
+    std::vector<MeshData> meshes;
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec3> normals;
     std::vector<glm::vec2> texcoords;
+    Bounds bounds;
 };
 
+/** Fills the bounds of the model and of every mesh */
+inline void computeBounds(ModelData& data) noexcept {
+    const auto& vertices = data.vertices;
+    data.bounds = Bounds::of(
+        vertices.size(), [&vertices](std::size_t i) { return vertices[i]; });
+    for (auto& mesh : data.meshes) {
+        std::visit(
+            [&mesh, &vertices](const auto& indices) {
+                mesh.bounds =
+                    Bounds::of(indices.size(), [&](std::size_t i) {
+                        return vertices[indices[i] + mesh.baseVertex];
+                    });
+            },
+            mesh.indices);
+    }
+}
+
+/** Camera and sun last passed to Model, shared by everything drawn with
+    the model lighting */
+struct Scene {
+    glm::mat4 view{1.f};
+    glm::mat4 projection{1.f};
+    glm::vec3 sunDirection{0.f};
+    glm::vec3 sunColor{0.f};
+    /** variant bits of the model program the lights call for */
+    uint32_t lighting = 0;
+    const HiZ* hiZ = nullptr;
+    const OcclusionBuffer* occlusion = nullptr;
+    RenderStats stats;
+};
+
+Scene& modelScene() noexcept;
+
+/** Loads 'filename' and runs the processing requested by 'options' */
+ModelData prepareModel(
+    std::string_view filename, const ModelOptions& options) noexcept;
+
 }  // namespace neat
@@ -0,0 +1,303 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <OcclusionBuffer.hh>
+
+#include "Parallel.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace neat {
+
+namespace {
+
+constexpr float nearEpsilon = 1e-5f;
+
+/** clips a triangle against the near plane (z = -w), giving up to four
+    vertices of a convex polygon */
+unsigned clipNear(const glm::vec4* in, glm::vec4* out) noexcept {
+    unsigned count = 0;
+    for (auto i = 0u; i < 3; ++i) {
+        const auto& a = in[i];
+        const auto& b = in[(i + 1) % 3];
+        auto da = a.z + a.w;
+        auto db = b.z + b.w;
+        if (da >= 0.f) {
+            out[count++] = a;
+        }
+        if ((da >= 0.f) != (db >= 0.f)) {
+            out[count++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+OcclusionBuffer::OcclusionBuffer(unsigned width, unsigned height) noexcept :
+    width_((width + tileSize - 1) / tileSize * tileSize),
+    height_((height + tileSize - 1) / tileSize * tileSize),
+    tilesX_(width_ / tileSize),
+    tilesY_(height_ / tileSize),
+    depth_(width_ * height_, 1.f),
+    blockMax_(depth_.size() / (blockSize * blockSize), 1.f),
+    bins_(tilesX_ * tilesY_) {
+}
+
+void OcclusionBuffer::begin(const glm::mat4& vp) noexcept {
+    vp_ = vp;
+    std::fill(depth_.begin(), depth_.end(), 1.f);
+    std::fill(blockMax_.begin(), blockMax_.end(), 1.f);
+    triangles_.clear();
+    for (auto& bin : bins_) {
+        bin.clear();
+    }
+}
+
+void OcclusionBuffer::add(const std::vector<glm::vec3>& vertices,
+    const std::vector<uint32_t>& indices, const glm::mat4& transform) noexcept {
+    auto mvp = vp_ * transform;
+    std::vector<glm::vec4> clip;
+    clip.reserve(vertices.size());
+    for (const auto& v : vertices) {
+        clip.push_back(mvp * glm::vec4(v, 1.f));
+    }
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+        glm::vec4 triangle[] = {
+            clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]};
+        bin(triangle);
+    }
+}
+
+void OcclusionBuffer::bin(const glm::vec4* clip) noexcept {
+    glm::vec4 polygon[4];
+    auto count = clipNear(clip, polygon);
+    if (count < 3) {
+        return;
+    }
+
+    glm::vec3 screen[4];
+    for (auto i = 0u; i < count; ++i) {
+        auto w = std::max(polygon[i].w, nearEpsilon);
+        auto ndc = glm::vec3(polygon[i]) / w;
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * width_,
+            (ndc.y * 0.5f + 0.5f) * height_,
+            std::max(0.f, ndc.z * 0.5f + 0.5f));
+    }
+
+    for (auto i = 2u; i < count; ++i) {
+        Triangle triangle{{screen[0], screen[i - 1], screen[i]}};
+        auto min = glm::min(glm::min(triangle.v[0], triangle.v[1]),
+            triangle.v[2]);
+        auto max = glm::max(glm::max(triangle.v[0], triangle.v[1]),
+            triangle.v[2]);
+        if (max.x < 0.f || max.y < 0.f || min.x >= width_ ||
+            min.y >= height_ || min.z > 1.f) {
+            continue;
+        }
+        auto tileX0 = static_cast<unsigned>(std::max(min.x, 0.f)) / tileSize;
+        auto tileY0 = static_cast<unsigned>(std::max(min.y, 0.f)) / tileSize;
+        auto tileX1 = std::min(
+            static_cast<unsigned>(max.x) / tileSize, tilesX_ - 1);
+        auto tileY1 = std::min(
+            static_cast<unsigned>(max.y) / tileSize, tilesY_ - 1);
+        auto index = static_cast<uint32_t>(triangles_.size());
+        triangles_.push_back(triangle);
+        for (auto y = tileY0; y <= tileY1; ++y) {
+            for (auto x = tileX0; x <= tileX1; ++x) {
+                bins_[y * tilesX_ + x].push_back(index);
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::end() noexcept {
+    parallelFor(bins_.size(), 1, [this](std::size_t begin, std::size_t end) {
+        for (auto tile = begin; tile < end; ++tile) {
+            rasterize(static_cast<unsigned>(tile));
+        }
+    });
+}
+
+void OcclusionBuffer::rasterize(unsigned tile) noexcept {
+    auto tileX = tile % tilesX_ * tileSize;
+    auto tileY = tile / tilesX_ * tileSize;
+
+    for (auto index : bins_[tile]) {
+        auto a = triangles_[index].v[0];
+        auto b = triangles_[index].v[1];
+        auto c = triangles_[index].v[2];
+        auto area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (area < 0.f) {
+            std::swap(b, c);
+            area = -area;
+        }
+        if (area < 1e-6f) {
+            continue;
+        }
+
+        // depth plane, moved to the farthest point of every pixel
+        auto dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) /
+                    area;
+        auto dzdy = ((b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z)) /
+                    area;
+        auto bias = 0.5f * (std::abs(dzdx) + std::abs(dzdy));
+        auto farthest = std::max({a.z, b.z, c.z});
+
+        auto minX = std::max(static_cast<int>(std::min({a.x, b.x, c.x})),
+            static_cast<int>(tileX));
+        auto maxX = std::min(static_cast<int>(std::max({a.x, b.x, c.x})),
+            static_cast<int>(tileX + tileSize) - 1);
+        auto minY = std::max(static_cast<int>(std::min({a.y, b.y, c.y})),
+            static_cast<int>(tileY));
+        auto maxY = std::min(static_cast<int>(std::max({a.y, b.y, c.y})),
+            static_cast<int>(tileY + tileSize) - 1);
+        minX &= ~3;
+
+        // edge functions, positive inside
+        glm::vec3 stepX(a.y - b.y, b.y - c.y, c.y - a.y);
+        for (auto y = minY; y <= maxY; ++y) {
+            auto px = minX + 0.5f;
+            auto py = y + 0.5f;
+            glm::vec3 edge((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x),
+                (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x),
+                (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x));
+            auto z = a.z + dzdx * (px - a.x) + dzdy * (py - a.y) + bias;
+            auto* row = &depth_[y * width_];
+#ifdef __SSE2__
+            auto lanes = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+            auto e0 = _mm_add_ps(_mm_set1_ps(edge.x),
+                _mm_mul_ps(lanes, _mm_set1_ps(stepX.x)));
+            auto e1 = _mm_add_ps(_mm_set1_ps(edge.y),
+                _mm_mul_ps(lanes, _mm_set1_ps(stepX.y)));
+            auto e2 = _mm_add_ps(_mm_set1_ps(edge.z),
+                _mm_mul_ps(lanes, _mm_set1_ps(stepX.z)));
+            auto depth = _mm_add_ps(
+                _mm_set1_ps(z), _mm_mul_ps(lanes, _mm_set1_ps(dzdx)));
+            auto step0 = _mm_set1_ps(4.f * stepX.x);
+            auto step1 = _mm_set1_ps(4.f * stepX.y);
+            auto step2 = _mm_set1_ps(4.f * stepX.z);
+            auto stepZ = _mm_set1_ps(4.f * dzdx);
+            auto maxZ = _mm_set1_ps(farthest);
+            auto zero = _mm_setzero_ps();
+            for (auto x = minX; x <= maxX; x += 4) {
+                auto inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                    _mm_cmpge_ps(e2, zero));
+                auto old = _mm_loadu_ps(row + x);
+                auto min = _mm_min_ps(old, _mm_min_ps(depth, maxZ));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, min),
+                                           _mm_andnot_ps(inside, old)));
+                e0 = _mm_add_ps(e0, step0);
+                e1 = _mm_add_ps(e1, step1);
+                e2 = _mm_add_ps(e2, step2);
+                depth = _mm_add_ps(depth, stepZ);
+            }
+#else
+            for (auto x = minX; x <= maxX; ++x) {
+                if (edge.x >= 0.f && edge.y >= 0.f && edge.z >= 0.f) {
+                    row[x] = std::min(row[x], std::min(z, farthest));
+                }
+                edge += stepX;
+                z += dzdx;
+            }
+#endif
+        }
+    }
+
+    auto blocksX = width_ / blockSize;
+    for (auto by = tileY / blockSize; by < (tileY + tileSize) / blockSize;
+         ++by) {
+        for (auto bx = tileX / blockSize; bx < (tileX + tileSize) / blockSize;
+             ++bx) {
+            auto max = 0.f;
+            for (auto y = by * blockSize; y < (by + 1) * blockSize; ++y) {
+                const auto* row = &depth_[y * width_ + bx * blockSize];
+                max = std::max(max, *std::max_element(row, row + blockSize));
+            }
+            blockMax_[by * blocksX + bx] = max;
+        }
+    }
+}
+
+bool OcclusionBuffer::visible(const glm::vec3& min, const glm::vec3& max,
+    const glm::mat4& transform) const noexcept {
+    auto mvp = vp_ * transform;
+    auto lower = glm::vec3(std::numeric_limits<float>::max());
+    auto upper = -lower;
+    for (auto i = 0u; i < 8; ++i) {
+        auto corner = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+            i & 4 ? max.z : min.z);
+        auto clip = mvp * glm::vec4(corner, 1.f);
+        if (clip.w <= nearEpsilon || clip.z < -clip.w) {
+            return true;
+        }
+        auto ndc = glm::vec3(clip) / clip.w;
+        lower = glm::min(lower, ndc);
+        upper = glm::max(upper, ndc);
+    }
+
+    auto x0 = std::max(0, static_cast<int>((lower.x * 0.5f + 0.5f) * width_));
+    auto y0 = std::max(0, static_cast<int>((lower.y * 0.5f + 0.5f) * height_));
+    auto x1 = std::min(static_cast<int>(width_) - 1,
+        static_cast<int>((upper.x * 0.5f + 0.5f) * width_));
+    auto y1 = std::min(static_cast<int>(height_) - 1,
+        static_cast<int>((upper.y * 0.5f + 0.5f) * height_));
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    auto nearest = lower.z * 0.5f + 0.5f;
+
+    auto blocksX = width_ / blockSize;
+    for (auto by = y0 / blockSize; by <= y1 / blockSize; ++by) {
+        for (auto bx = x0 / blockSize; bx <= x1 / blockSize; ++bx) {
+            if (blockMax_[by * blocksX + bx] < nearest) {
+                continue;
+            }
+            auto yEnd = std::min<int>(y1, (by + 1) * blockSize - 1);
+            auto xEnd = std::min<int>(x1, (bx + 1) * blockSize - 1);
+            for (auto y = std::max<int>(y0, by * blockSize); y <= yEnd; ++y) {
+                for (auto x = std::max<int>(x0, bx * blockSize); x <= xEnd;
+                     ++x) {
+                    if (depth_[y * width_ + x] >= nearest) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+unsigned OcclusionBuffer::width() const noexcept {
+    return width_;
+}
+
+unsigned OcclusionBuffer::height() const noexcept {
+    return height_;
+}
+
+const std::vector<float>& OcclusionBuffer::depth() const noexcept {
+    return depth_;
+}
+
+}  // namespace neat
@@ -0,0 +1,183 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cmath>
+
+#include <GLES3/gl32.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <GLResource.hh>
+#include <GLState.hh>
+#include <Program.hh>
+
+#include "ModelData.hh"
+
+namespace neat {
+
+// clang-format off
+inline const char* occlusionBoxV = GLSL(
+
+uniform mat4 vp;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+void main() {
+    int bit = 1 << gl_VertexID;
+    vec3 corner = vec3((0x287a & bit) != 0, (0x02af & bit) != 0,
+                       (0x31e3 & bit) != 0);
+    gl_Position = vp * vec4(mix(boxMin, boxMax, corner), 1.);
+}
+);
+
+inline const char* occlusionBoxF = GLSL(
+
+layout (location = 0) out vec4 color;
+
+void main() {
+    color = vec4(1.);
+}
+);
+// clang-format on
+
+/** Tests a world-space box with GL_ANY_SAMPLES_PASSED_CONSERVATIVE. The
+    result of a query is only read once available, usually a frame later,
+    and a visible object stays drawn for a few frames before it may hide
+    again so that it does not flicker */
+class OcclusionQuery : private GLResource {
+    static constexpr unsigned holdFrames = 8;
+
+    bool pending_ = false;
+    bool stale_ = false;
+    bool occluded_ = false;
+    unsigned hold_ = 0;
+
+    /** the box program and its uniforms, resolved once */
+    struct Shader {
+        Program program = Program({{GL_FRAGMENT_SHADER, occlusionBoxF},
+            {GL_VERTEX_SHADER, occlusionBoxV}});
+        Uniform<glm::mat4> vp = program.uniform<glm::mat4>("vp");
+        Uniform<glm::vec3> boxMin = program.uniform<glm::vec3>("boxMin");
+        Uniform<glm::vec3> boxMax = program.uniform<glm::vec3>("boxMax");
+    };
+
+    static Shader& shader() noexcept {
+        static Shader shader;
+        return shader;
+    }
+
+    void collect() noexcept {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(id_, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) {
+            return;
+        }
+        GLuint passed = GL_FALSE;
+        glGetQueryObjectuiv(id_, GL_QUERY_RESULT, &passed);
+        pending_ = false;
+        if (stale_) {
+            stale_ = false;
+        } else if (passed != GL_FALSE) {
+            occluded_ = false;
+            hold_ = holdFrames;
+        } else {
+            occluded_ = hold_ == 0;
+        }
+    }
+
+    void issue(const glm::vec3& min, const glm::vec3& max,
+        RenderStats& stats) noexcept {
+        const auto& scene = modelScene();
+        auto& shader = OcclusionQuery::shader();
+        shader.program.use();
+        shader.vp.set(scene.projection * scene.view);
+        shader.boxMin.set(min);
+        shader.boxMax.set(max);
+
+        GLboolean depthMask = GL_TRUE;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        auto& state = GLState::instance();
+        auto cullFace = state.enabled(GL_CULL_FACE);
+        state.bindVertexArray(0);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        state.enable(GL_CULL_FACE, false);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, id_);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+        glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(depthMask);
+        state.enable(GL_CULL_FACE, cullFace);
+        pending_ = true;
+        ++stats.queries;
+    }
+
+  public:
+    OcclusionQuery() noexcept {
+        glGenQueries(1, &id_);
+    }
+
+    OcclusionQuery(OcclusionQuery&& rhs) noexcept :
+        GLResource(std::move(rhs)),
+        pending_(rhs.pending_),
+        stale_(rhs.stale_),
+        occluded_(rhs.occluded_),
+        hold_(rhs.hold_) {
+    }
+
+    ~OcclusionQuery() noexcept {
+        if (id_ != 0) {
+            glDeleteQueries(1, &id_);
+        }
+    }
+
+    /** forgets the results so far, for boxes that moved */
+    void invalidate() noexcept {
+        occluded_ = false;
+        stale_ = pending_;
+    }
+
+    /** returns whether the box may be visible, judging by the latest
+        result, and queries it again once that result has arrived, counted
+        in 'stats' */
+    bool test(const glm::vec3& min, const glm::vec3& max,
+        RenderStats& stats) noexcept {
+        if (hold_ > 0) {
+            --hold_;
+        }
+        if (pending_) {
+            collect();
+        }
+
+        const auto& scene = modelScene();
+        auto eye = glm::vec3(glm::inverse(scene.view)[3]);
+        auto near = std::abs(
+            scene.projection[3][2] / (scene.projection[2][2] - 1.f));
+        if (glm::all(glm::greaterThanEqual(eye, min - 2.f * near)) &&
+            glm::all(glm::lessThanEqual(eye, max + 2.f * near))) {
+            // the near plane would clip the box
+            occluded_ = false;
+            return true;
+        }
+        if (!pending_) {
+            issue(min, max, stats);
+        }
+        return !occluded_;
+    }
+};
+
+}  // namespace neat
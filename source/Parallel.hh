@@ -0,0 +1,33 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include <Jobs.hh>
+
+namespace neat {
+
+/** Splits [0, count) into chunks of at least 'grain' items and calls
+    func(begin, end) for every chunk on the shared job system, the first
+    one on the calling thread */
+template <class Func>
+void parallelFor(std::size_t count, std::size_t grain, Func func) {
+    Jobs::instance().parallelFor(count, grain, func);
+}
+
+}  // namespace neat
@@ -14,110 +14,412 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <functional>
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <utility>
 
-#include <GLES3/gl3.h>
+#include <GLES3/gl32.h>
+#include <glm/gtc/type_ptr.hpp>
 
+#include <GLState.hh>
 #include <Log.hh>
 #include <Program.hh>
 
+#include "ProgramCache.hh"
+
 namespace neat {
 
 namespace {
 
-using AttachFunc = std::function<void(GLuint, GLuint)>;
-using AttachWraper = std::function<void(AttachFunc, GLuint)>;
+constexpr GLenum CompletionStatus = 0x91B1;  // GL_COMPLETION_STATUS_KHR
 
-GLuint compile(GLenum shaderType, const char* src) {
+/** issues the compile, checkShader queries how it went; 'prelude' goes
+    right after the #version line */
+GLuint compile(GLenum shaderType, const char* src, std::string_view prelude) {
     GLuint shader = glCreateShader(shaderType);
     if (shader) {
-        glShaderSource(shader, 1, &src, nullptr);
+        std::string_view source(src);
+        auto split = source.rfind("#version", 0) == 0 ? source.find('\n') : 0;
+        split = split == std::string_view::npos ? source.size() : split + 1;
+        std::array<const char*, 3> strings{
+            src, prelude.empty() ? "" : prelude.data(), src + split};
+        std::array<GLint, 3> lengths{static_cast<GLint>(split),
+            static_cast<GLint>(prelude.size()),
+            static_cast<GLint>(source.size() - split)};
+        glShaderSource(shader, 3, strings.data(), lengths.data());
         glCompileShader(shader);
-        GLint compiled = GL_FALSE;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    }
+    return shader;
+}
+
+void checkShader(GLuint shader) {
+    GLint size;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &size);
+    if (size) {
+        std::unique_ptr<char[]> buffer = std::make_unique<char[]>(size);
+        glGetShaderInfoLog(shader, size, nullptr, buffer.get());
+        Log() << buffer.get();
+    }
+}
 
+bool checkProgram(GLuint program) {
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
         GLint size;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &size);
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &size);
         if (size) {
             std::unique_ptr<char[]> buffer = std::make_unique<char[]>(size);
-            glGetShaderInfoLog(shader, size, nullptr, buffer.get());
+            glGetProgramInfoLog(program, size, nullptr, buffer.get());
             Log() << buffer.get();
         }
-
-        if (!compiled) {
-            glDeleteShader(shader);
-            shader = 0;
-        }
     }
-    return shader;
+    return linkStatus == GL_TRUE;
 }
 
-GLuint program(AttachWraper wrapper) {
-    GLuint program = glCreateProgram();
-    if (program) {
-        wrapper(glAttachShader, program);
-        glLinkProgram(program);
-
-        GLint linkStatus = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-        if (linkStatus != GL_TRUE) {
-            GLint size;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &size);
-            if (size) {
-                std::unique_ptr<char[]> buffer = std::make_unique<char[]>(size);
-                glGetProgramInfoLog(program, size, nullptr, buffer.get());
-                Log() << buffer.get();
+/** GL_KHR_parallel_shader_compile lets ready() ask without waiting */
+bool parallelCompile() noexcept {
+    static auto supported = [] {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const auto* name = reinterpret_cast<const char*>(
+                glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (name &&
+                std::string_view(name) == "GL_KHR_parallel_shader_compile") {
+                return true;
             }
-            wrapper(glDetachShader, program);
-            glDeleteProgram(program);
-            program = 0;
         }
+        return false;
+    }();
+    return supported;
+}
+
+std::string& cacheDirectory() {
+    static std::string directory;
+    return directory;
+}
+
+template <class T>
+struct GLType;
+
+template <>
+struct GLType<float> {
+    static constexpr GLenum value = GL_FLOAT;
+};
+
+template <>
+struct GLType<int> {
+    static constexpr GLenum value = GL_INT;
+};
+
+template <>
+struct GLType<unsigned> {
+    static constexpr GLenum value = GL_UNSIGNED_INT;
+};
+
+template <>
+struct GLType<glm::vec2> {
+    static constexpr GLenum value = GL_FLOAT_VEC2;
+};
+
+template <>
+struct GLType<glm::vec3> {
+    static constexpr GLenum value = GL_FLOAT_VEC3;
+};
+
+template <>
+struct GLType<glm::vec4> {
+    static constexpr GLenum value = GL_FLOAT_VEC4;
+};
+
+template <>
+struct GLType<glm::mat4> {
+    static constexpr GLenum value = GL_FLOAT_MAT4;
+};
+
+bool isOpaque(GLenum type) noexcept {
+    switch (type) {
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_IMAGE_2D:
+        case GL_INT_IMAGE_2D:
+        case GL_UNSIGNED_INT_IMAGE_2D:
+            return true;
+        default:
+            return false;
     }
-    return program;
+}
+
+/** samplers and images are set with int, bools with int or unsigned */
+bool compatible(GLenum active, GLenum wanted) noexcept {
+    return active == wanted ||
+           (wanted == GL_INT && isOpaque(active)) ||
+           ((wanted == GL_INT || wanted == GL_UNSIGNED_INT) &&
+               active == GL_BOOL);
+}
+
+void setUniform(GLint location, const float* values, GLsizei count) {
+    glUniform1fv(location, count, values);
+}
+
+void setUniform(GLint location, const int* values, GLsizei count) {
+    glUniform1iv(location, count, values);
+}
+
+void setUniform(GLint location, const unsigned* values, GLsizei count) {
+    glUniform1uiv(location, count, values);
+}
+
+void setUniform(GLint location, const glm::vec2* values, GLsizei count) {
+    glUniform2fv(location, count, glm::value_ptr(*values));
+}
+
+void setUniform(GLint location, const glm::vec3* values, GLsizei count) {
+    glUniform3fv(location, count, glm::value_ptr(*values));
+}
+
+void setUniform(GLint location, const glm::vec4* values, GLsizei count) {
+    glUniform4fv(location, count, glm::value_ptr(*values));
+}
+
+void setUniform(GLint location, const glm::mat4* values, GLsizei count) {
+    glUniformMatrix4fv(location, count, GL_FALSE, glm::value_ptr(*values));
 }
 
 }  // namespace
 
-Program::Program(const std::vector<ShaderInfo>& shaders) noexcept {
-    std::vector<GLuint> compiled;
-    for (const auto& shader : shaders) {
-        compiled.emplace_back(compile(shader.type, shader.source));
+template <class T>
+void Uniform<T>::set(const T* values, std::size_t count) const noexcept {
+    setUniform(location_, values, static_cast<GLsizei>(count));
+}
+
+Program::Program(const std::vector<ShaderInfo>& shaders,
+    std::string_view prelude, Build build) noexcept {
+    start(shaders, prelude);
+    if (build == Build::Now) {
+        finish();
     }
-    id_ = program([compiled](AttachFunc func, GLuint p) {
-        for (const auto& c : compiled) {
-            func(p, c);
-        }
-    });
 }
 
-Program::Program(Program&& rhs) noexcept : GLResource(std::move(rhs)) {
+Program::Program(Program&& rhs) noexcept :
+    GLResource(std::move(rhs)),
+    uniforms_(std::move(rhs.uniforms_)),
+    shaders_(std::move(rhs.shaders_)),
+    cache_(std::move(rhs.cache_)),
+    pending_(std::exchange(rhs.pending_, false)) {
 }
 
 Program& Program::operator=(Program&& rhs) noexcept {
     GLResource::operator=(std::move(rhs));
+    uniforms_ = std::move(rhs.uniforms_);
+    shaders_ = std::move(rhs.shaders_);
+    cache_ = std::move(rhs.cache_);
+    pending_ = std::exchange(rhs.pending_, false);
     return *this;
 }
 
-void Program::use() const noexcept {
-    glUseProgram(id_);
+Program::~Program() noexcept {
 }
 
-unsigned int Program::uniform(const char* name) noexcept {
-    auto found = uniforms_.find(name);
-    if (found != uniforms_.end()) {
-        return found->second;
+void Program::start(
+    const std::vector<ShaderInfo>& shaders, std::string_view prelude) noexcept {
+    cache_ = std::make_unique<ProgramCache>(cacheDirectory(), shaders, prelude);
+    id_ = glCreateProgram();
+    if (id_ == 0) {
+        return;
+    }
+    if (cache_->enabled()) {
+        if (cache_->load(id_)) {
+            cache_.reset();
+            reflect();
+            return;
+        }
+        // stale, or written by another driver
+        glDeleteProgram(id_);
+        id_ = glCreateProgram();
+        glProgramParameteri(id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     }
-    auto result = glGetUniformLocation(id_, name);
-    uniforms_[name] = result;
-    if (result == GL_INVALID_VALUE) {
-        Log() << "cant get uniform " << name;
+    for (const auto& shader : shaders) {
+        auto compiled = compile(shader.type, shader.source, prelude);
+        if (compiled != 0) {
+            glAttachShader(id_, compiled);
+            shaders_.push_back(compiled);
+        }
     }
-    return result;
+    glLinkProgram(id_);
+    pending_ = true;
+}
+
+void Program::finish() noexcept {
+    if (!pending_) {
+        return;
+    }
+    pending_ = false;
+    for (auto shader : shaders_) {
+        checkShader(shader);
+        glDetachShader(id_, shader);
+        glDeleteShader(shader);
+    }
+    shaders_.clear();
+    if (!checkProgram(id_)) {
+        glDeleteProgram(id_);
+        id_ = 0;
+    } else if (cache_->enabled()) {
+        cache_->store(id_);
+    }
+    cache_.reset();
+    reflect();
+}
+
+bool Program::ready() noexcept {
+    if (pending_ && parallelCompile()) {
+        GLint complete = GL_FALSE;
+        glGetProgramiv(id_, CompletionStatus, &complete);
+        if (complete != GL_TRUE) {
+            return false;
+        }
+    }
+    finish();
+    return true;
+}
+
+bool Program::pending() const noexcept {
+    return pending_;
+}
+
+void Program::setCacheDirectory(std::string_view directory) noexcept {
+    cacheDirectory() = directory;
+}
+
+void Program::reflect() noexcept {
+    GLint count = 0;
+    GLint length = 0;
+    if (id_ != 0) {
+        glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+    }
+    std::string buffer(static_cast<std::size_t>(length), '\0');
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei written = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id_, static_cast<GLuint>(i), length, &written,
+            &size, &type, buffer.data());
+        auto name = buffer.substr(0, static_cast<std::size_t>(written));
+        // members of uniform blocks have none
+        auto location = glGetUniformLocation(id_, name.c_str());
+        if (location < 0) {
+            continue;
+        }
+        constexpr std::string_view suffix = "[0]";
+        if (name.size() > suffix.size() &&
+            name.compare(name.size() - suffix.size(), suffix.size(),
+                suffix) == 0) {
+            name.resize(name.size() - suffix.size());
+        }
+        uniforms_.push_back({std::move(name), location, type});
+    }
+    std::sort(uniforms_.begin(), uniforms_.end(),
+        [](const Active& a, const Active& b) { return a.name < b.name; });
+}
+
+int Program::find(std::string_view name, unsigned type) const noexcept {
+    auto found = std::lower_bound(uniforms_.begin(), uniforms_.end(), name,
+        [](const Active& active, std::string_view key) {
+            return active.name < key;
+        });
+    if (found == uniforms_.end() || found->name != name) {
+        Log() << "Program: no active uniform " << name;
+        return -1;
+    }
+    if (!compatible(found->type, type)) {
+        Log() << "Program: uniform " << name << " has another type";
+        return -1;
+    }
+    return found->location;
+}
+
+template <class T>
+Uniform<T> Program::uniform(std::string_view name) const noexcept {
+    return Uniform<T>(find(name, GLType<T>::value));
+}
+
+void Program::use() const noexcept {
+    GLState::instance().useProgram(id_);
 }
 
 unsigned int Program::getRawId() const noexcept {
     return id_;
 }
 
+ProgramVariants::ProgramVariants(
+    std::vector<ShaderInfo> shaders, Prelude prelude) noexcept :
+    shaders_(std::move(shaders)), prelude_(prelude) {
+}
+
+Program& ProgramVariants::get(uint32_t key) noexcept {
+    auto found = programs_.find(key);
+    if (found == programs_.end()) {
+        found = programs_.try_emplace(key, shaders_, prelude_(key)).first;
+    }
+    found->second.finish();
+    return found->second;
+}
+
+void ProgramVariants::request(uint32_t key) noexcept {
+    if (programs_.find(key) == programs_.end()) {
+        programs_.try_emplace(
+            key, shaders_, prelude_(key), Program::Build::Async);
+    }
+}
+
+bool ProgramVariants::ready(uint32_t key) noexcept {
+    request(key);
+    return programs_.find(key)->second.ready();
+}
+
+void ProgramVariants::poll() noexcept {
+    for (auto& [key, program] : programs_) {
+        program.ready();
+    }
+}
+
+void ProgramVariants::finish() noexcept {
+    for (auto& [key, program] : programs_) {
+        program.finish();
+    }
+}
+
+const Program* ProgramVariants::find(uint32_t key) const noexcept {
+    auto found = programs_.find(key);
+    return found != programs_.end() && !found->second.pending()
+               ? &found->second
+               : nullptr;
+}
+
+template class Uniform<float>;
+template class Uniform<int>;
+template class Uniform<unsigned>;
+template class Uniform<glm::vec2>;
+template class Uniform<glm::vec3>;
+template class Uniform<glm::vec4>;
+template class Uniform<glm::mat4>;
+
+template Uniform<float> Program::uniform(std::string_view) const noexcept;
+template Uniform<int> Program::uniform(std::string_view) const noexcept;
+template Uniform<unsigned> Program::uniform(std::string_view) const noexcept;
+template Uniform<glm::vec2> Program::uniform(std::string_view) const noexcept;
+template Uniform<glm::vec3> Program::uniform(std::string_view) const noexcept;
+template Uniform<glm::vec4> Program::uniform(std::string_view) const noexcept;
+template Uniform<glm::mat4> Program::uniform(std::string_view) const noexcept;
+
 }  // namespace neat
@@ -0,0 +1,170 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl3.h>
+#include <unistd.h>
+
+#include <Log.hh>
+#include <Program.hh>
+
+namespace neat {
+
+/** Stores linked program binaries under the hash of their sources. The
+    header keeps the hash of the driver too, so an entry written by another
+    driver, or one the driver rejects, is relinked and overwritten */
+class ProgramCache {
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t size;
+    };
+#pragma pack(pop)
+
+    enum : uint32_t { Magic = 0x4e455450, Version = 1 };
+
+    std::filesystem::path path_;
+    uint64_t key_ = 0;
+
+    static uint64_t hash(const void* data, std::size_t size,
+        uint64_t result = 0xcbf29ce484222325) noexcept {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            result = (result ^ bytes[i]) * 0x100000001b3;
+        }
+        return result;
+    }
+
+    static uint64_t hash(const char* text, uint64_t result) noexcept {
+        return text ? hash(text, std::char_traits<char>::length(text), result)
+                    : result;
+    }
+
+    static uint64_t driver() noexcept {
+        static auto result = [] {
+            auto string = [](GLenum name) {
+                return reinterpret_cast<const char*>(glGetString(name));
+            };
+            return hash(string(GL_VERSION),
+                hash(string(GL_RENDERER), hash(string(GL_VENDOR), 0)));
+        }();
+        return result;
+    }
+
+  public:
+    /** disabled without a directory or when the driver has no binary
+        format */
+    ProgramCache(std::string_view directory,
+        const std::vector<ShaderInfo>& shaders,
+        std::string_view prelude) noexcept {
+        if (directory.empty()) {
+            return;
+        }
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0) {
+            return;
+        }
+        auto sources = hash(prelude.data(), prelude.size());
+        for (const auto& shader : shaders) {
+            sources = hash(&shader.type, sizeof(shader.type), sources);
+            sources = hash(shader.source, sources);
+        }
+        key_ = sources ^ driver();
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << sources
+             << ".program";
+        path_ = std::filesystem::path(directory) / name.str();
+    }
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return key_ != 0;
+    }
+
+    /** links 'program' from the stored binary */
+    bool load(unsigned program) const noexcept {
+        std::ifstream file(path_, std::ios::binary | std::ios::ate);
+        auto end = static_cast<std::streamoff>(file.tellg());
+        file.seekg(0);
+        Header header;  // NOLINT(hicpp-member-init)
+        if (key_ == 0 || !file ||
+            !file.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+            header.magic != Magic || header.version != Version ||
+            header.key != key_ ||
+            static_cast<std::streamoff>(header.size) >
+                end - static_cast<std::streamoff>(sizeof(Header))) {
+            return false;
+        }
+        std::vector<char> binary(header.size);
+        if (!file.read(binary.data(), binary.size())) {
+            return false;
+        }
+        glProgramBinary(program, header.format, binary.data(),
+            static_cast<GLsizei>(binary.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    void store(unsigned program) const noexcept {
+        GLint size = 0;
+        if (key_ != 0) {
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+        }
+        if (size <= 0) {
+            return;
+        }
+        std::vector<char> binary(static_cast<std::size_t>(size));
+        GLenum format = 0;
+        glGetProgramBinary(program, size, &size, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(path_.parent_path(), error);
+        // processes sharing the directory only ever see whole entries
+        auto temporary = path_;
+        temporary += "." + std::to_string(getpid());
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            Log() << "error: cannot write cache " << path_.string();
+            return;
+        }
+        Header header{
+            Magic, Version, key_, format, static_cast<uint32_t>(size)};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), size);
+        file.close();
+        if (file) {
+            std::filesystem::rename(temporary, path_, error);
+        }
+        if (!file || error) {
+            Log() << "error: cannot write cache " << path_.string();
+            std::filesystem::remove(temporary, error);
+        }
+    }
+};
+
+}  // namespace neat
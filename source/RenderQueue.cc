@@ -0,0 +1,767 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <GLES3/gl32.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <GLState.hh>
+#include <Log.hh>
+#include <RenderQueue.hh>
+
+#include "LinearAllocator.hh"
+
+namespace neat {
+
+namespace {
+
+struct Entry {
+    uint64_t key;
+    RenderCommand* command;
+};
+
+/** replaces the instances of the commands recorded after it in its list */
+struct Upload {
+    unsigned buffer;
+    const void* data;
+    std::size_t size;
+    std::size_t firstEntry;
+};
+
+/** uploads of one buffer in a submit */
+struct Uploaded {
+    std::size_t size = 0;
+    std::size_t offset = 0;
+    unsigned count = 0;
+};
+
+constexpr auto PassShift = 60u;
+constexpr uint64_t DepthMask = (1u << 24) - 1;
+constexpr uint64_t ProgramMask = (1u << 10) - 1;
+constexpr uint64_t MaterialMask = (1u << 16) - 1;
+constexpr uint64_t TextureMask = (1u << 10) - 1;
+constexpr auto Unknown = std::numeric_limits<unsigned>::max();
+constexpr std::size_t InstanceSize = sizeof(glm::vec4) * 4;
+
+std::size_t instanceBytes(std::size_t size) noexcept {
+    return (size + InstanceSize - 1) / InstanceSize * InstanceSize;
+}
+
+GLint integer(GLenum name) noexcept {
+    GLint value = 0;
+    glGetIntegerv(name, &value);
+    return value;
+}
+
+/** renderbuffer formats of the framebuffer bound, drivers may compile a
+    pipeline for each of them */
+struct Formats {
+    GLenum color = GL_RGBA8;
+    GLenum depth = GL_NONE;
+    GLenum depthAttachment = GL_NONE;
+    GLsizei samples = 0;
+};
+
+Formats framebufferFormats(GLint framebuffer) noexcept {
+    auto query = [](GLenum attachment, GLenum name) {
+        GLint value = 0;
+        glGetFramebufferAttachmentParameteriv(
+            GL_FRAMEBUFFER, attachment, name, &value);
+        return value;
+    };
+    // the default framebuffer names its buffers instead of attachments
+    auto color = framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0;
+    auto depth = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+    auto stencil = framebuffer == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+    auto attached = [&query](GLenum attachment) {
+        return query(attachment, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE) !=
+               GL_NONE;
+    };
+
+    Formats result;
+    result.samples = integer(GL_SAMPLES);
+    if (attached(color)) {
+        auto red = query(color, GL_FRAMEBUFFER_ATTACHMENT_RED_SIZE);
+        auto blue = query(color, GL_FRAMEBUFFER_ATTACHMENT_BLUE_SIZE);
+        auto alpha = query(color, GL_FRAMEBUFFER_ATTACHMENT_ALPHA_SIZE);
+        if (query(color, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE) ==
+            GL_FLOAT) {
+            result.color = blue == 10 ? GL_R11F_G11F_B10F : GL_RGBA16F;
+        } else if (query(color, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING) ==
+                   GL_SRGB) {
+            result.color = GL_SRGB8_ALPHA8;
+        } else if (red == 10) {
+            result.color = GL_RGB10_A2;
+        } else if (red == 5) {
+            result.color = alpha == 1 ? GL_RGB5_A1 : GL_RGB565;
+        } else if (red == 4) {
+            result.color = GL_RGBA4;
+        } else {
+            result.color = alpha == 0 ? GL_RGB8 : GL_RGBA8;
+        }
+    }
+    auto depthBits = attached(depth)
+                         ? query(depth, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE)
+                         : 0;
+    auto stencilBits =
+        attached(stencil)
+            ? query(stencil, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE)
+            : 0;
+    if (stencilBits > 0) {
+        result.depth = depthBits > 24 ? GL_DEPTH32F_STENCIL8
+                       : depthBits > 0 ? GL_DEPTH24_STENCIL8
+                                       : GL_STENCIL_INDEX8;
+        result.depthAttachment = depthBits > 0 ? GL_DEPTH_STENCIL_ATTACHMENT
+                                               : GL_STENCIL_ATTACHMENT;
+    } else if (depthBits > 0) {
+        result.depth = depthBits > 24 ? GL_DEPTH_COMPONENT32F
+                       : depthBits > 16 ? GL_DEPTH_COMPONENT24
+                                        : GL_DEPTH_COMPONENT16;
+        result.depthAttachment = GL_DEPTH_ATTACHMENT;
+    }
+    return result;
+}
+
+/** bindings prewarm() changes, put back once it is done */
+struct Bindings {
+    struct Block {
+        unsigned index;
+        GLint buffer;
+        GLint64 offset;
+        GLint64 size;
+    };
+
+    GLint program = integer(GL_CURRENT_PROGRAM);
+    GLint vertexArray = integer(GL_VERTEX_ARRAY_BINDING);
+    GLint arrayBuffer = integer(GL_ARRAY_BUFFER_BINDING);
+    GLint indirectBuffer = integer(GL_DRAW_INDIRECT_BUFFER_BINDING);
+    GLint uniformBuffer = integer(GL_UNIFORM_BUFFER_BINDING);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    unsigned unit = integer(GL_ACTIVE_TEXTURE) - GL_TEXTURE0;
+    GLint texture = integer(GL_TEXTURE_BINDING_2D);
+    GLint texture0 = texture;
+    std::vector<Block> blocks;
+
+    Bindings() noexcept {
+        if (unit != 0) {
+            glActiveTexture(GL_TEXTURE0);
+            texture0 = integer(GL_TEXTURE_BINDING_2D);
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    void saveBlock(unsigned index) {
+        Block block{index, 0, 0, 0};
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, index, &block.buffer);
+        glGetInteger64i_v(GL_UNIFORM_BUFFER_START, index, &block.offset);
+        glGetInteger64i_v(GL_UNIFORM_BUFFER_SIZE, index, &block.size);
+        blocks.push_back(block);
+    }
+
+    void restore(GLState& gl) const noexcept {
+        for (const auto& block : blocks) {
+            if (block.size == 0) {
+                gl.bindBufferBase(GL_UNIFORM_BUFFER, block.index,
+                    static_cast<unsigned>(block.buffer));
+            } else {
+                gl.bindBufferRange(GL_UNIFORM_BUFFER, block.index,
+                    static_cast<unsigned>(block.buffer),
+                    static_cast<std::size_t>(block.offset),
+                    static_cast<std::size_t>(block.size));
+            }
+        }
+        gl.bindBuffer(GL_UNIFORM_BUFFER, static_cast<unsigned>(uniformBuffer));
+        gl.useProgram(static_cast<unsigned>(program));
+        gl.bindVertexArray(static_cast<unsigned>(vertexArray));
+        gl.bindBuffer(GL_ARRAY_BUFFER, static_cast<unsigned>(arrayBuffer));
+        gl.bindBuffer(
+            GL_DRAW_INDIRECT_BUFFER, static_cast<unsigned>(indirectBuffer));
+        gl.enable(GL_BLEND, blend == GL_TRUE);
+        // the active unit last, as the caller left it
+        gl.bindTexture(0, static_cast<unsigned>(texture0));
+        gl.bindTexture(unit, static_cast<unsigned>(texture));
+    }
+};
+
+/** top 24 bits of a positive float keep its order */
+uint64_t depthBits(float depth) noexcept {
+    if (!(depth > 0.f)) {
+        return 0;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 7;
+}
+
+/** draws binding the same uniform block range and setting the same
+    uniform values share a material */
+uint64_t materialBits(const RenderCommand& command,
+    const RenderQueue::Uniform* uniforms, std::size_t count) noexcept {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+    if (command.blockBuffer != 0) {
+        mix(&command.blockBuffer, sizeof(command.blockBuffer));
+        mix(&command.blockOffset, sizeof(command.blockOffset));
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        mix(glm::value_ptr(uniforms[i].value), sizeof(glm::vec4));
+    }
+    return (hash ^ (hash >> 16)) & MaterialMask;
+}
+
+/** stable LSD radix sort on bytes, skipping those every key shares */
+void radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch) {
+    scratch.resize(entries.size());
+    for (auto shift = 0u; shift < 64; shift += 8) {
+        std::array<std::size_t, 256> counts{};
+        for (const auto& entry : entries) {
+            ++counts[(entry.key >> shift) & 0xff];
+        }
+        if (std::find(counts.begin(), counts.end(), entries.size()) !=
+            counts.end()) {
+            continue;
+        }
+        std::size_t offset = 0;
+        for (auto& count : counts) {
+            offset += std::exchange(count, offset);
+        }
+        for (const auto& entry : entries) {
+            scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+/** uniforms are stored right after their command */
+const RenderQueue::Uniform* uniformsOf(const RenderCommand& command) noexcept {
+    return reinterpret_cast<const RenderQueue::Uniform*>(&command + 1);
+}
+
+}  // namespace
+
+class RenderQueue::List::Impl {
+    LinearAllocator memory_;
+    std::vector<Entry> entries_;
+    std::vector<Upload> uploads_;
+
+  public:
+    void add(Pass pass, float depth, const RenderCommand& command,
+        std::initializer_list<Uniform> uniforms) noexcept {
+        static_assert(sizeof(RenderCommand) % alignof(Uniform) == 0);
+        auto* memory = static_cast<std::byte*>(
+            memory_.allocate(sizeof(RenderCommand) +
+                                 sizeof(Uniform) * uniforms.size(),
+                alignof(RenderCommand)));
+        auto* recorded = new (memory) RenderCommand(command);
+        recorded->uniforms = static_cast<uint32_t>(uniforms.size());
+        std::uninitialized_copy(uniforms.begin(), uniforms.end(),
+            reinterpret_cast<Uniform*>(memory + sizeof(RenderCommand)));
+
+        auto program = command.program & ProgramMask;
+        auto material =
+            materialBits(command, uniforms.begin(), uniforms.size());
+        auto texture = command.texture & TextureMask;
+        auto key = static_cast<uint64_t>(pass) << PassShift;
+        switch (pass) {
+            case Pass::Opaque:
+                key |= program << 50 | material << 34 | texture << 24 |
+                       depthBits(depth);
+                break;
+            case Pass::Transparent:
+                key |= (~depthBits(depth) & DepthMask) << 36 |
+                       program << 26 | material << 10 | texture;
+                break;
+            case Pass::Overlay:
+                // the sort is stable, overlays keep their order
+                break;
+        }
+        entries_.push_back({key, recorded});
+    }
+
+    void upload(unsigned buffer, const void* data, std::size_t size) noexcept {
+        auto* copy = memory_.copy(static_cast<const std::byte*>(data), size);
+        uploads_.push_back({buffer, copy, size, entries_.size()});
+    }
+
+    void clear() noexcept {
+        entries_.clear();
+        uploads_.clear();
+        memory_.reset();
+    }
+
+    [[nodiscard]] const std::vector<Entry>& entries() const noexcept {
+        return entries_;
+    }
+
+    [[nodiscard]] std::vector<Entry>& entries() noexcept {
+        return entries_;
+    }
+
+    [[nodiscard]] const std::vector<Upload>& uploads() const noexcept {
+        return uploads_;
+    }
+};
+
+class RenderQueue::Impl {
+    struct Instances {
+        unsigned buffer;
+        unsigned attrib;
+        unsigned first;
+    };
+
+    List list_;
+    std::vector<List*> merged_;
+    std::vector<Entry> entries_;
+    std::vector<Entry> scratch_;
+    std::unordered_map<uint64_t, glm::vec4> uniformCache_;
+    std::unordered_map<unsigned, Instances> instances_;
+    std::unordered_map<unsigned, uint64_t> blocks_;
+    std::unordered_map<unsigned, Uploaded> uploaded_;
+    std::unordered_map<unsigned, unsigned> rebase_;
+    Stats stats_;
+    GLState& gl_ = GLState::instance();
+
+    // GL state set by the current submit, Unknown before it is
+    unsigned program_ = Unknown;
+    unsigned vertexArray_ = Unknown;
+    unsigned arrayBuffer_ = Unknown;
+    unsigned vertexBuffer_ = Unknown;
+    unsigned indexBuffer_ = Unknown;
+    unsigned indirectBuffer_ = Unknown;
+    unsigned texture_ = Unknown;
+    unsigned blend_ = Unknown;
+
+    template <class Apply>
+    void change(unsigned& current, unsigned value, Apply&& apply) noexcept {
+        if (current == value) {
+            ++stats_.redundant;
+            return;
+        }
+        current = value;
+        ++stats_.changes;
+        apply();
+    }
+
+    void bindArrayBuffer(unsigned buffer) noexcept {
+        change(arrayBuffer_, buffer,
+            [this, buffer] { gl_.bindBuffer(GL_ARRAY_BUFFER, buffer); });
+    }
+
+    void setInstances(const Instances& instances) noexcept {
+        bindArrayBuffer(instances.buffer);
+        for (auto i = 0u; i < 4; ++i) {
+            glVertexAttribPointer(instances.attrib + i, 4, GL_FLOAT, GL_FALSE,
+                sizeof(glm::vec4) * 4,
+                reinterpret_cast<const void*>(sizeof(glm::vec4) *
+                                              (4 * instances.first + i)));
+        }
+    }
+
+    void setUniform(unsigned program, const Uniform& uniform) noexcept {
+        auto key = (static_cast<uint64_t>(program) << 32) |
+                   static_cast<uint32_t>(uniform.location);
+        auto [it, inserted] = uniformCache_.try_emplace(key, uniform.value);
+        if (!inserted && it->second == uniform.value) {
+            ++stats_.redundant;
+            return;
+        }
+        it->second = uniform.value;
+        ++stats_.changes;
+        const auto* value = glm::value_ptr(uniform.value);
+        switch (uniform.size) {
+            case 1:
+                glUniform1fv(uniform.location, 1, value);
+                break;
+            case 2:
+                glUniform2fv(uniform.location, 1, value);
+                break;
+            case 3:
+                glUniform3fv(uniform.location, 1, value);
+                break;
+            default:
+                glUniform4fv(uniform.location, 1, value);
+                break;
+        }
+    }
+
+    void bind(Pass pass, const RenderCommand& command) noexcept {
+        change(blend_, pass == Pass::Opaque ? 0 : 1,
+            [this, pass] { gl_.enable(GL_BLEND, pass != Pass::Opaque); });
+        change(program_, command.program,
+            [this, &command] { gl_.useProgram(command.program); });
+        change(vertexArray_, command.vertexArray, [this, &command] {
+            gl_.bindVertexArray(command.vertexArray);
+            // the element array binding belongs to the vertex array
+            indexBuffer_ = Unknown;
+        });
+        if (command.vertexArray == 0) {
+            change(vertexBuffer_, command.vertexBuffer, [this, &command] {
+                bindArrayBuffer(command.vertexBuffer);
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+            });
+        }
+        if (command.indexBuffer != 0) {
+            change(indexBuffer_, command.indexBuffer, [this, &command] {
+                gl_.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, command.indexBuffer);
+            });
+        }
+        if (command.instanceBuffer != 0) {
+            Instances wanted{command.instanceBuffer, command.instanceAttrib,
+                command.firstInstance};
+            auto [it, inserted] =
+                instances_.try_emplace(command.vertexArray, wanted);
+            if (!inserted && it->second.buffer == wanted.buffer &&
+                it->second.first == wanted.first) {
+                ++stats_.redundant;
+            } else {
+                it->second = wanted;
+                ++stats_.changes;
+                setInstances(wanted);
+            }
+        }
+        if (command.indirectBuffer != 0) {
+            change(indirectBuffer_, command.indirectBuffer, [this, &command] {
+                gl_.bindBuffer(GL_DRAW_INDIRECT_BUFFER, command.indirectBuffer);
+            });
+        }
+        if (command.texture != 0) {
+            change(texture_, command.texture,
+                [this, &command] { gl_.bindTexture(0, command.texture); });
+        }
+        if (command.blockBuffer != 0) {
+            auto block = static_cast<uint64_t>(command.blockBuffer) << 32 |
+                         command.blockOffset;
+            auto& bound = blocks_[command.blockBinding];
+            if (bound == block) {
+                ++stats_.redundant;
+            } else {
+                bound = block;
+                ++stats_.changes;
+                gl_.bindBufferRange(GL_UNIFORM_BUFFER, command.blockBinding,
+                    command.blockBuffer, command.blockOffset,
+                    command.blockSize);
+            }
+        }
+        const auto* uniforms = uniformsOf(command);
+        for (auto i = 0u; i < command.uniforms; ++i) {
+            setUniform(command.program, uniforms[i]);
+        }
+    }
+
+    static void draw(const RenderCommand& command) noexcept {
+        const auto* offset = reinterpret_cast<const void*>(command.offset);
+        switch (command.kind) {
+            case RenderCommand::Kind::Arrays:
+                glDrawArraysInstanced(GL_TRIANGLES,
+                    static_cast<GLint>(command.offset), command.count,
+                    command.instances);
+                break;
+            case RenderCommand::Kind::Elements:
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count,
+                    command.indexType, offset, command.instances,
+                    command.baseVertex);
+                break;
+            case RenderCommand::Kind::ElementsIndirect:
+                glDrawElementsIndirect(
+                    GL_TRIANGLES, command.indexType, offset);
+                break;
+        }
+    }
+
+    /** leaves the state immediate rendering expects */
+    void restore() noexcept {
+        for (const auto& [vertexArray, instances] : instances_) {
+            if (instances.first != 0) {
+                gl_.bindVertexArray(vertexArray);
+                setInstances({instances.buffer, instances.attrib, 0});
+            }
+        }
+        gl_.bindVertexArray(0);
+        gl_.enable(GL_BLEND, false);
+        gl_.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    /** every list, the own one first */
+    template <class Func>
+    void forLists(Func&& func) noexcept {
+        func(*list_.pImpl_);
+        for (auto* list : merged_) {
+            func(*list->pImpl_);
+        }
+    }
+
+    /** applies the uploads and sorts the commands of every list */
+    void prepare() noexcept {
+        stats_ = {};
+        program_ = vertexArray_ = arrayBuffer_ = vertexBuffer_ = Unknown;
+        indexBuffer_ = indirectBuffer_ = texture_ = blend_ = Unknown;
+        uniformCache_.clear();
+        instances_.clear();
+        blocks_.clear();
+
+        uploaded_.clear();
+        forLists([this](const List::Impl& list) {
+            for (const auto& upload : list.uploads()) {
+                auto& uploaded = uploaded_[upload.buffer];
+                uploaded.size += instanceBytes(upload.size);
+                ++uploaded.count;
+            }
+        });
+        entries_.clear();
+        forLists([this](List::Impl& list) {
+            upload(list);
+            entries_.insert(
+                entries_.end(), list.entries().begin(), list.entries().end());
+        });
+        radixSort(entries_, scratch_);
+    }
+
+    /** a buffer uploaded several times, e.g. by a model recorded for two
+        views, holds every upload one after the other; the commands
+        recorded after each upload read their instances from it */
+    void upload(List::Impl& list) noexcept {
+        const auto& uploads = list.uploads();
+        auto& entries = list.entries();
+        rebase_.clear();
+        std::size_t next = 0;
+        for (std::size_t i = 0; i <= entries.size(); ++i) {
+            for (; next < uploads.size() && uploads[next].firstEntry == i;
+                 ++next) {
+                const auto& upload = uploads[next];
+                auto& uploaded = uploaded_[upload.buffer];
+                bindArrayBuffer(upload.buffer);
+                if (uploaded.count == 1) {
+                    glBufferData(GL_ARRAY_BUFFER,
+                        static_cast<GLsizeiptr>(upload.size), upload.data,
+                        GL_DYNAMIC_DRAW);
+                    continue;
+                }
+                if (uploaded.offset == 0) {
+                    glBufferData(GL_ARRAY_BUFFER,
+                        static_cast<GLsizeiptr>(uploaded.size), nullptr,
+                        GL_DYNAMIC_DRAW);
+                }
+                glBufferSubData(GL_ARRAY_BUFFER,
+                    static_cast<GLintptr>(uploaded.offset),
+                    static_cast<GLsizeiptr>(upload.size), upload.data);
+                rebase_[upload.buffer] =
+                    static_cast<unsigned>(uploaded.offset / InstanceSize);
+                uploaded.offset += instanceBytes(upload.size);
+            }
+            if (i == entries.size() || rebase_.empty()) {
+                continue;
+            }
+            auto& command = *entries[i].command;
+            auto it = rebase_.find(command.instanceBuffer);
+            if (command.instanceBuffer != 0 && it != rebase_.end()) {
+                command.firstInstance += it->second;
+            }
+        }
+    }
+
+  public:
+    List& list() noexcept {
+        return list_;
+    }
+
+    void merge(List& list) noexcept {
+        merged_.push_back(&list);
+    }
+
+    void submit() noexcept {
+        prepare();
+        for (const auto& entry : entries_) {
+            bind(static_cast<Pass>(entry.key >> PassShift), *entry.command);
+            draw(*entry.command);
+            ++stats_.commands;
+        }
+        restore();
+        clear();
+    }
+
+    std::vector<Prewarmed> prewarm() noexcept {
+        constexpr GLsizei Size = 4;
+        Bindings bindings;
+        auto framebuffer = integer(GL_FRAMEBUFFER_BINDING);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        auto formats = framebufferFormats(framebuffer);
+        std::array<GLuint, 2> renderbuffers{};
+        GLuint fbo = 0;
+        glGenRenderbuffers(2, renderbuffers.data());
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorageMultisample(
+            GL_RENDERBUFFER, formats.samples, formats.color, Size, Size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER, renderbuffers[0]);
+        if (formats.depth != GL_NONE) {
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+            glRenderbufferStorageMultisample(
+                GL_RENDERBUFFER, formats.samples, formats.depth, Size, Size);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, formats.depthAttachment,
+                GL_RENDERBUFFER, renderbuffers[1]);
+        }
+        glViewport(0, 0, Size, Size);
+
+        prepare();
+        std::vector<Prewarmed> result;
+        std::set<std::tuple<unsigned, unsigned, RenderCommand::Kind, Pass>>
+            drawn;
+        std::set<unsigned> blocks;
+        for (const auto& entry : entries_) {
+            if (entry.command->blockBuffer != 0 &&
+                blocks.insert(entry.command->blockBinding).second) {
+                bindings.saveBlock(entry.command->blockBinding);
+            }
+        }
+        for (const auto& entry : entries_) {
+            auto pass = static_cast<Pass>(entry.key >> PassShift);
+            auto command = *entry.command;
+            if (!drawn.emplace(command.program, command.vertexArray,
+                          command.kind, pass)
+                     .second) {
+                continue;
+            }
+            // one triangle is enough to specialize the pipeline
+            if (command.kind != RenderCommand::Kind::ElementsIndirect) {
+                command.count = std::min(command.count, 3u);
+                command.instances = std::min(command.instances, 1u);
+            }
+            auto start = std::chrono::steady_clock::now();
+            bind(pass, *entry.command);
+            draw(command);
+            glFinish();
+            std::chrono::duration<float, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            result.push_back(
+                {command.program, command.vertexArray, pass, elapsed.count()});
+            ++stats_.commands;
+        }
+        restore();
+        clear();
+        bindings.restore(gl_);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(framebuffer));
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(2, renderbuffers.data());
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        auto total = 0.f;
+        for (const auto& prewarmed : result) {
+            total += prewarmed.milliseconds;
+        }
+        Log() << "RenderQueue: prewarmed " << result.size()
+              << " pipelines in " << total << " ms";
+        return result;
+    }
+
+    void clear() noexcept {
+        forLists([](List::Impl& list) { list.clear(); });
+        merged_.clear();
+        entries_.clear();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        auto result = list_.size();
+        for (const auto* list : merged_) {
+            result += list->size();
+        }
+        return result;
+    }
+
+    [[nodiscard]] const Stats& stats() const noexcept {
+        return stats_;
+    }
+};
+
+RenderQueue::List::List() noexcept {
+}
+
+RenderQueue::List::~List() noexcept {
+}
+
+void RenderQueue::List::add(Pass pass, float depth,
+    const RenderCommand& command,
+    std::initializer_list<Uniform> uniforms) noexcept {
+    pImpl_->add(pass, depth, command, uniforms);
+}
+
+void RenderQueue::List::upload(
+    unsigned buffer, const void* data, std::size_t size) noexcept {
+    pImpl_->upload(buffer, data, size);
+}
+
+void RenderQueue::List::clear() noexcept {
+    pImpl_->clear();
+}
+
+std::size_t RenderQueue::List::size() const noexcept {
+    return pImpl_->entries().size();
+}
+
+RenderQueue::RenderQueue() noexcept {
+}
+
+RenderQueue::~RenderQueue() noexcept {
+}
+
+RenderQueue::List& RenderQueue::list() noexcept {
+    return pImpl_->list();
+}
+
+void RenderQueue::merge(List& list) noexcept {
+    pImpl_->merge(list);
+}
+
+void RenderQueue::submit() noexcept {
+    pImpl_->submit();
+}
+
+std::vector<RenderQueue::Prewarmed> RenderQueue::prewarm() noexcept {
+    return pImpl_->prewarm();
+}
+
+void RenderQueue::clear() noexcept {
+    pImpl_->clear();
+}
+
+std::size_t RenderQueue::size() const noexcept {
+    return pImpl_->size();
+}
+
+const RenderQueue::Stats& RenderQueue::stats() const noexcept {
+    return pImpl_->stats();
+}
+
+}  // namespace neat
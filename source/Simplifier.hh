@@ -0,0 +1,307 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "MeshOptimizer.hh"
+
+namespace neat::simplifier {
+
+struct Quadric {
+    float a00, a01, a02, a11, a12, a22;
+    float b0, b1, b2;
+    float c;
+    float weight;
+
+    static Quadric plane(const glm::vec3& n, float d, float weight) noexcept {
+        return {n.x * n.x * weight, n.x * n.y * weight, n.x * n.z * weight,
+            n.y * n.y * weight, n.y * n.z * weight, n.z * n.z * weight,
+            n.x * d * weight, n.y * d * weight, n.z * d * weight,
+            d * d * weight, weight};
+    }
+
+    Quadric& operator+=(const Quadric& q) noexcept {
+        a00 += q.a00;
+        a01 += q.a01;
+        a02 += q.a02;
+        a11 += q.a11;
+        a12 += q.a12;
+        a22 += q.a22;
+        b0 += q.b0;
+        b1 += q.b1;
+        b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+        return *this;
+    }
+
+    /** Mean squared distance from 'p' to the accumulated planes */
+    [[nodiscard]] float error(const glm::vec3& p) const noexcept {
+        auto e = p.x * (a00 * p.x + 2.f * (a01 * p.y + a02 * p.z + b0)) +
+                 p.y * (a11 * p.y + 2.f * (a12 * p.z + b1)) +
+                 p.z * (a22 * p.z + 2.f * b2) + c;
+        return weight > 0.f ? std::abs(e) / weight : 0.f;
+    }
+};
+
+/** Quadric error metric edge collapse onto existing vertices. Border and
+    attribute seam vertices stay in place, so the result can reuse the
+    original vertex buffer */
+inline std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices,
+    const std::vector<glm::vec3>& positions, float maxError) {
+    std::vector<uint32_t> vertices(indices);
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()),
+        vertices.end());
+    auto vertexCount = vertices.size();
+    auto triangleCount = indices.size() / 3;
+
+    std::vector<uint32_t> triangles(indices.size());
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        triangles[i] = std::lower_bound(vertices.begin(), vertices.end(),
+                           indices[i]) -
+                       vertices.begin();
+    }
+    auto position = [&](uint32_t v) -> const glm::vec3& {
+        return positions[vertices[v]];
+    };
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    std::vector<std::vector<uint32_t>> adjacency(vertexCount);
+    for (std::size_t t = 0; t < triangleCount; ++t) {
+        const auto* tri = &triangles[t * 3];
+        auto n = glm::cross(position(tri[1]) - position(tri[0]),
+            position(tri[2]) - position(tri[0]));
+        auto area = glm::length(n);
+        if (area > 0.f) {
+            n /= area;
+        }
+        auto q = Quadric::plane(n, -glm::dot(n, position(tri[0])), area);
+        for (auto k = 0u; k < 3; ++k) {
+            quadrics[tri[k]] += q;
+            adjacency[tri[k]].push_back(t);
+        }
+    }
+
+    std::vector<bool> locked(vertexCount, false);
+    struct PositionHash {
+        std::size_t operator()(const glm::vec3& p) const noexcept {
+            auto h = std::hash<float>();
+            return h(p.x) ^ (h(p.y) * 31) ^ (h(p.z) * 131);
+        }
+    };
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> seams(vertexCount);
+    for (auto v = 0u; v < vertexCount; ++v) {
+        auto [found, inserted] = seams.emplace(position(v), v);
+        if (!inserted) {
+            locked[v] = true;
+            locked[found->second] = true;
+        }
+    }
+
+    using Edge = std::pair<uint32_t, uint32_t>;
+    std::vector<Edge> edges;
+    auto collectEdges = [&](const std::vector<bool>& alive) {
+        edges.clear();
+        for (std::size_t t = 0; t < triangleCount; ++t) {
+            if (!alive[t]) {
+                continue;
+            }
+            for (auto k = 0u; k < 3; ++k) {
+                auto a = triangles[t * 3 + k];
+                auto b = triangles[t * 3 + (k + 1) % 3];
+                edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+    };
+
+    std::vector<bool> alive(triangleCount, true);
+    collectEdges(alive);
+    for (std::size_t i = 0; i < edges.size();) {
+        auto j = i;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            ++j;
+        }
+        if (j - i != 2) {
+            locked[edges[i].first] = true;
+            locked[edges[i].second] = true;
+        }
+        i = j;
+    }
+
+    auto flips = [&](uint32_t from, uint32_t to) {
+        for (auto t : adjacency[from]) {
+            const auto* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                continue;
+            }
+            glm::vec3 p[3] = {position(tri[0]), position(tri[1]),
+                position(tri[2])};
+            auto before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            for (auto k = 0u; k < 3; ++k) {
+                if (tri[k] == from) {
+                    p[k] = position(to);
+                }
+            }
+            auto after = glm::cross(p[1] - p[0], p[2] - p[0]);
+            if (glm::dot(before, after) <= 0.f) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<bool> touched(vertexCount);
+    auto limit = maxError * maxError;
+
+    for (;;) {
+        collapses.clear();
+        for (std::size_t i = 0; i < edges.size(); ++i) {
+            if (i != 0 && edges[i] == edges[i - 1]) {
+                continue;
+            }
+            auto [a, b] = edges[i];
+            auto q = quadrics[a];
+            q += quadrics[b];
+            auto toB = locked[a] ? limit + 1.f : q.error(position(b));
+            auto toA = locked[b] ? limit + 1.f : q.error(position(a));
+            if (toB <= toA && toB <= limit) {
+                collapses.push_back({a, b, toB});
+            } else if (toA < toB && toA <= limit) {
+                collapses.push_back({b, a, toA});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& l, const Collapse& r) {
+                return l.error < r.error;
+            });
+
+        std::fill(touched.begin(), touched.end(), false);
+        auto applied = 0u;
+        for (const auto& collapse : collapses) {
+            if (touched[collapse.from] || touched[collapse.to] ||
+                flips(collapse.from, collapse.to)) {
+                continue;
+            }
+            for (auto t : adjacency[collapse.from]) {
+                auto* tri = &triangles[t * 3];
+                for (auto k = 0u; k < 3; ++k) {
+                    touched[tri[k]] = true;
+                    if (tri[k] == collapse.from) {
+                        tri[k] = collapse.to;
+                    }
+                }
+                if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+                    alive[t] = false;
+                } else {
+                    adjacency[collapse.to].push_back(t);
+                }
+            }
+            adjacency[collapse.from].clear();
+            quadrics[collapse.to] += quadrics[collapse.from];
+            ++applied;
+        }
+        if (applied == 0) {
+            break;
+        }
+
+        for (auto& triangleList : adjacency) {
+            triangleList.erase(
+                std::remove_if(triangleList.begin(), triangleList.end(),
+                    [&alive](uint32_t t) { return !alive[t]; }),
+                triangleList.end());
+        }
+        collectEdges(alive);
+    }
+
+    std::vector<uint32_t> result;
+    for (std::size_t t = 0; t < triangleCount; ++t) {
+        if (alive[t]) {
+            for (auto k = 0u; k < 3; ++k) {
+                result.push_back(vertices[triangles[t * 3 + k]]);
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace neat::simplifier
+
+namespace neat {
+
+/** Appends a LOD to every mesh for each of 'errors', given relative to
+    the model radius. Every LOD simplifies the previous one */
+inline void generateLods(ModelData& data, const std::vector<float>& errors,
+    std::string_view name) noexcept {
+    if (data.vertices.empty()) {
+        return;
+    }
+    auto min = data.vertices[0];
+    auto max = data.vertices[0];
+    for (const auto& v : data.vertices) {
+        min = glm::min(min, v);
+        max = glm::max(max, v);
+    }
+    auto radius = glm::length(max - min) / 2.f;
+
+    parallelFor(data.meshes.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto m = begin; m < end; ++m) {
+            auto& mesh = data.meshes[m];
+            auto indices = optimizer::expand(mesh);
+            for (auto error : errors) {
+                indices = simplifier::simplify(
+                    indices, data.vertices, error * radius);
+                optimizer::optimizeVertexCache(indices);
+                std::visit(
+                    [&mesh, &indices](const auto& base) {
+                        using Indices = std::decay_t<decltype(base)>;
+                        Indices lod;
+                        lod.reserve(indices.size());
+                        for (auto index : indices) {
+                            lod.push_back(index - mesh.baseVertex);
+                        }
+                        mesh.lods.emplace_back(std::move(lod));
+                    },
+                    mesh.indices);
+            }
+        }
+    });
+
+    Log log;
+    log << name << ": LOD triangles";
+    for (auto lod = 0u; lod <= errors.size(); ++lod) {
+        std::size_t triangles = 0;
+        for (const auto& mesh : data.meshes) {
+            triangles += mesh.count(lod) / 3;
+        }
+        log << " " << triangles;
+    }
+}
+
+}  // namespace neat
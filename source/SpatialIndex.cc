@@ -0,0 +1,349 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include <SpatialIndex.hh>
+
+#include "Culling.hh"
+
+namespace neat {
+
+namespace {
+
+Box merge(const Box& a, const Box& b) noexcept {
+    return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+float area(const Box& box) noexcept {
+    auto size = box.max - box.min;
+    return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool contains(const Box& outer, const Box& inner) noexcept {
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) &&
+           glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+/** distance along the ray where it enters the box, if it does */
+std::optional<float> enter(const Box& box, const glm::vec3& origin,
+    const glm::vec3& inverse, float limit) noexcept {
+    auto t0 = (box.min - origin) * inverse;
+    auto t1 = (box.max - origin) * inverse;
+    auto near = glm::min(t0, t1);
+    auto far = glm::max(t0, t1);
+    auto entry = std::max({near.x, near.y, near.z, 0.f});
+    auto exit = std::min({far.x, far.y, far.z, limit});
+    if (entry > exit) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+}  // namespace
+
+SpatialIndex::SpatialIndex(float margin) noexcept : margin_(margin) {
+}
+
+int SpatialIndex::allocate() noexcept {
+    if (free_.empty()) {
+        nodes_.emplace_back();
+        return static_cast<int>(nodes_.size() - 1);
+    }
+    auto node = free_.back();
+    free_.pop_back();
+    nodes_[node] = Node{};
+    return node;
+}
+
+void SpatialIndex::refit(int node) noexcept {
+    auto& parent = nodes_[node];
+    const auto& a = nodes_[parent.children[0]];
+    const auto& b = nodes_[parent.children[1]];
+    parent.height = 1 + std::max(a.height, b.height);
+    parent.box = merge(a.box, b.box);
+}
+
+void SpatialIndex::insertLeaf(int leaf) noexcept {
+    if (root_ == -1) {
+        root_ = leaf;
+        nodes_[leaf].parent = -1;
+        return;
+    }
+
+    // descend to the sibling giving the smallest total area
+    auto box = nodes_[leaf].box;
+    auto index = root_;
+    while (!nodes_[index].leaf()) {
+        const auto& node = nodes_[index];
+        auto combined = area(merge(node.box, box));
+        auto cost = 2.f * combined;
+        auto inheritance = 2.f * (combined - area(node.box));
+        float childCost[2];
+        for (auto i = 0; i < 2; ++i) {
+            const auto& child = nodes_[node.children[i]];
+            childCost[i] = area(merge(child.box, box)) + inheritance;
+            if (!child.leaf()) {
+                childCost[i] -= area(child.box);
+            }
+        }
+        if (cost < childCost[0] && cost < childCost[1]) {
+            break;
+        }
+        index = node.children[childCost[0] < childCost[1] ? 0 : 1];
+    }
+
+    auto sibling = index;
+    auto oldParent = nodes_[sibling].parent;
+    auto parent = allocate();
+    nodes_[parent].parent = oldParent;
+    nodes_[parent].box = merge(nodes_[sibling].box, box);
+    nodes_[parent].height = nodes_[sibling].height + 1;
+    nodes_[parent].children[0] = sibling;
+    nodes_[parent].children[1] = leaf;
+    if (oldParent == -1) {
+        root_ = parent;
+    } else {
+        auto& children = nodes_[oldParent].children;
+        children[children[0] == sibling ? 0 : 1] = parent;
+    }
+    nodes_[sibling].parent = parent;
+    nodes_[leaf].parent = parent;
+
+    for (index = parent; index != -1; index = nodes_[index].parent) {
+        index = balance(index);
+        refit(index);
+    }
+}
+
+void SpatialIndex::removeLeaf(int leaf) noexcept {
+    if (leaf == root_) {
+        root_ = -1;
+        return;
+    }
+
+    auto parent = nodes_[leaf].parent;
+    auto grandParent = nodes_[parent].parent;
+    const auto& children = nodes_[parent].children;
+    auto sibling = children[children[0] == leaf ? 1 : 0];
+    nodes_[parent].height = -1;
+    free_.push_back(parent);
+    nodes_[sibling].parent = grandParent;
+    if (grandParent == -1) {
+        root_ = sibling;
+        return;
+    }
+
+    auto& siblings = nodes_[grandParent].children;
+    siblings[siblings[0] == parent ? 0 : 1] = sibling;
+    for (auto index = grandParent; index != -1;
+         index = nodes_[index].parent) {
+        index = balance(index);
+        refit(index);
+    }
+}
+
+/** rotates the taller grandchild of 'a' up when its children heights
+    differ by more than one, returning the node now in its place */
+int SpatialIndex::balance(int a) noexcept {
+    if (nodes_[a].leaf() || nodes_[a].height < 2) {
+        return a;
+    }
+
+    auto b = nodes_[a].children[0];
+    auto c = nodes_[a].children[1];
+    auto difference = nodes_[c].height - nodes_[b].height;
+    if (difference >= -1 && difference <= 1) {
+        return a;
+    }
+
+    // 'up' is the taller child, 'side' which of a's slots it held
+    auto side = difference > 1 ? 1 : 0;
+    auto up = side == 1 ? c : b;
+    auto other = side == 1 ? b : c;
+    auto f = nodes_[up].children[0];
+    auto g = nodes_[up].children[1];
+
+    nodes_[up].children[0] = a;
+    nodes_[up].parent = nodes_[a].parent;
+    nodes_[a].parent = up;
+    if (auto parent = nodes_[up].parent; parent == -1) {
+        root_ = up;
+    } else {
+        auto& children = nodes_[parent].children;
+        children[children[0] == a ? 0 : 1] = up;
+    }
+
+    // the shorter grandchild moves under 'a'
+    auto keep = nodes_[f].height > nodes_[g].height ? f : g;
+    auto move = keep == f ? g : f;
+    nodes_[up].children[1] = keep;
+    nodes_[a].children[side] = move;
+    nodes_[move].parent = a;
+    nodes_[a].box = merge(nodes_[other].box, nodes_[move].box);
+    nodes_[a].height =
+        1 + std::max(nodes_[other].height, nodes_[move].height);
+    nodes_[up].box = merge(nodes_[a].box, nodes_[keep].box);
+    nodes_[up].height = 1 + std::max(nodes_[a].height, nodes_[keep].height);
+    return up;
+}
+
+int SpatialIndex::insert(const Box& box, uint32_t data) noexcept {
+    auto leaf = allocate();
+    auto grow = (box.max - box.min) * margin_;
+    nodes_[leaf].box = {box.min - grow, box.max + grow};
+    nodes_[leaf].data = data;
+    insertLeaf(leaf);
+    return leaf;
+}
+
+void SpatialIndex::update(int id, const Box& box) noexcept {
+    if (contains(nodes_[id].box, box)) {
+        return;
+    }
+    removeLeaf(id);
+    auto grow = (box.max - box.min) * margin_;
+    nodes_[id].box = {box.min - grow, box.max + grow};
+    insertLeaf(id);
+}
+
+void SpatialIndex::remove(int id) noexcept {
+    removeLeaf(id);
+    nodes_[id].height = -1;
+    free_.push_back(id);
+}
+
+void SpatialIndex::clear() noexcept {
+    nodes_.clear();
+    free_.clear();
+    root_ = -1;
+}
+
+void SpatialIndex::query(
+    const glm::mat4& vp, std::vector<uint32_t>& result) const noexcept {
+    if (root_ == -1) {
+        return;
+    }
+    auto frustum = Frustum::fromMatrix(vp);
+    // the sign bit marks nodes already known to be inside
+    std::vector<int> stack{root_};
+    while (!stack.empty()) {
+        auto index = stack.back();
+        stack.pop_back();
+        auto inside = index < 0;
+        const auto& node = nodes_[inside ? ~index : index];
+        if (!inside) {
+            auto outside = false;
+            inside = true;
+            for (const auto& plane : frustum.planes) {
+                auto normal = glm::vec3(plane);
+                auto positive = glm::mix(node.box.min, node.box.max,
+                    glm::greaterThanEqual(normal, glm::vec3(0.f)));
+                auto negative = node.box.min + node.box.max - positive;
+                if (glm::dot(normal, positive) + plane.w < 0.f) {
+                    outside = true;
+                    break;
+                }
+                inside = inside && glm::dot(normal, negative) + plane.w >= 0.f;
+            }
+            if (outside) {
+                continue;
+            }
+        }
+        if (node.leaf()) {
+            result.push_back(node.data);
+            continue;
+        }
+        for (auto child : node.children) {
+            stack.push_back(inside ? ~child : child);
+        }
+    }
+}
+
+void SpatialIndex::query(const glm::vec3& center, float radius,
+    std::vector<uint32_t>& result) const noexcept {
+    if (root_ == -1) {
+        return;
+    }
+    std::vector<int> stack{root_};
+    while (!stack.empty()) {
+        const auto& node = nodes_[stack.back()];
+        stack.pop_back();
+        auto closest = glm::clamp(center, node.box.min, node.box.max);
+        if (glm::dot(closest - center, closest - center) > radius * radius) {
+            continue;
+        }
+        if (node.leaf()) {
+            result.push_back(node.data);
+            continue;
+        }
+        stack.push_back(node.children[0]);
+        stack.push_back(node.children[1]);
+    }
+}
+
+std::optional<RayHit> SpatialIndex::raycast(const glm::vec3& origin,
+    const glm::vec3& direction,
+    const std::function<std::optional<float>(uint32_t)>& hit) const
+    noexcept {
+    if (root_ == -1) {
+        return std::nullopt;
+    }
+    auto inverse = 1.f / direction;
+    std::optional<RayHit> best;
+    auto limit = std::numeric_limits<float>::max();
+
+    std::vector<std::pair<int, float>> stack{{root_, 0.f}};
+    while (!stack.empty()) {
+        auto [index, entry] = stack.back();
+        stack.pop_back();
+        if (entry >= limit) {
+            continue;
+        }
+        const auto& node = nodes_[index];
+        if (node.leaf()) {
+            if (auto distance = hit(node.data);
+                distance && *distance < limit) {
+                limit = *distance;
+                best = RayHit{node.data, *distance};
+            }
+            continue;
+        }
+
+        std::optional<float> entries[2];
+        for (auto i = 0; i < 2; ++i) {
+            entries[i] = enter(
+                nodes_[node.children[i]].box, origin, inverse, limit);
+        }
+        // the nearer child goes on top of the stack
+        auto nearer = entries[1] && (!entries[0] || *entries[1] < *entries[0])
+                          ? 1
+                          : 0;
+        for (auto i : {1 - nearer, nearer}) {
+            if (entries[i]) {
+                stack.emplace_back(node.children[i], *entries[i]);
+            }
+        }
+    }
+    return best;
+}
+
+int SpatialIndex::height() const noexcept {
+    return root_ == -1 ? 0 : nodes_[root_].height;
+}
+
+}  // namespace neat
@@ -14,6 +14,8 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <glm/gtc/type_ptr.hpp>
+
 #include <Text.hh>
 #include <Program.hh>
 
@@ -54,10 +56,7 @@ void main() {
 
 Text::Text(const Font& font) noexcept : font_(font) {
     glEnableVertexAttribArray(0);
-    if (!program_) {
-        program_ =
-            Program({{GL_FRAGMENT_SHADER, textF}, {GL_VERTEX_SHADER, textV}});
-    }
+    initProgram();
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     program_->use();
     buffer_.bind();
@@ -67,6 +66,7 @@ Text::Text(std::string_view text, float x, float y, const Font& font) noexcept :
     Text(font) {
     auto vertexes = font_.calculate(text, x, y);
     buffer_.set(vertexes.data(), sizeof(glm::vec4) * vertexes.size());
+    count_ = vertexes.size();
 }
 
 Text::Text(const std::vector<Entry>& values, const Font& font) noexcept :
@@ -77,10 +77,13 @@ Text::Text(const std::vector<Entry>& values, const Font& font) noexcept :
         data.insert(data.end(), vertexes.begin(), vertexes.end());
     }
     buffer_.set(data.data(), sizeof(glm::vec4) * data.size());
+    count_ = data.size();
 }
 
 Text::Text(Text&& other) noexcept :
-    buffer_(std::move(other.buffer_)), font_(other.font_) {
+    buffer_(std::move(other.buffer_)),
+    font_(other.font_),
+    count_(other.count_) {
 }
 
 void Text::render() const noexcept {
@@ -88,30 +91,59 @@ void Text::render() const noexcept {
     font_.bind();
     buffer_.bind();
     program_->use();
+    setUniforms();
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glDrawArrays(GL_TRIANGLES, 0, buffer_.size() / sizeof(glm::vec4));
+    glDrawArrays(GL_TRIANGLES, 0, count_);
+}
+
+void Text::render(RenderQueue::List& list) const noexcept {
+    RenderCommand command;
+    command.kind = RenderCommand::Kind::Arrays;
+    command.program = program_->getRawId();
+    command.vertexBuffer = buffer_.getRawId();
+    command.texture = font_.getRawTextureId();
+    command.count = count_;
+    list.add(RenderQueue::Pass::Overlay, 0.f, command,
+        {{shiftUniform_.location(), 2,
+             glm::vec4(shift_.x, shift_.y, 0.f, 0.f)},
+            {colorUniform_.location(), 4, color_}});
+}
+
+void Text::initProgram() {
+    if (!program_) {
+        program_ =
+            Program({{GL_FRAGMENT_SHADER, textF}, {GL_VERTEX_SHADER, textV}});
+        shiftUniform_ = program_->uniform<glm::vec2>("shift");
+        colorUniform_ = program_->uniform<glm::vec4>("inputColor");
+    }
+}
+
+/** a queue submit may have left other values in the program */
+void Text::setUniforms() noexcept {
+    shiftUniform_.set(shift_);
+    colorUniform_.set(color_);
 }
 
 void Text::move(float x, float y) noexcept {
+    shift_ = {x, y};
     program_->use();
-    glUniform2f(program_->uniform("shift"), x, y);
+    setUniforms();
 }
 
 void Text::setColor(float r, float g, float b) {
+    color_ = {r, g, b, 1.f};
     program_->use();
-    glUniform4f(program_->uniform("inputColor"), r, g, b, 1.f);
+    setUniforms();
 }
 
 void Text::draw(std::string_view text, const Font& font, float x, float y) {
     auto data = font.calculate(text, x, y);
     Buffer::unbind(Buffer::Target::Array);
     font.bind();
-    if (!program_) {
-        program_ =
-            Program({{GL_FRAGMENT_SHADER, textF}, {GL_VERTEX_SHADER, textV}});
-    }
+    initProgram();
 
     program_->use();
+    setUniforms();
     Blending blending;
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, data.data());
     glDrawArrays(GL_TRIANGLES, 0, data.size());
@@ -18,6 +18,7 @@
 
 #include <GLES3/gl3.h>
 
+#include <GLState.hh>
 #include <Texture.hh>
 
 namespace neat {
@@ -52,17 +53,21 @@ Texture& Texture::operator=(Texture&& rhs) noexcept {
 
 Texture::~Texture() {
     if (id_ != 0) {
+        GLState::instance().deleteTexture(id_);
         glDeleteTextures(1, &id_);
     }
 }
 
 void Texture::bind() const noexcept {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, id_);
+    GLState::instance().bindTexture(0, id_);
+}
+
+unsigned int Texture::getRawId() const noexcept {
+    return id_;
 }
 
 void Texture::unbind() {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::instance().bindTexture(0, 0);
 }
 
 }  // namespace neat
@@ -0,0 +1,51 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Transform.hh>
+
+#include "TransformKernels.hh"
+
+namespace neat::transform {
+
+namespace {
+
+const Kernels& selected() noexcept {
+    static const auto& kernels = select();
+    return kernels;
+}
+
+}  // namespace
+
+void multiply(const glm::mat4* a, const glm::mat4* b, glm::mat4* result,
+    std::size_t count) noexcept {
+    selected().multiply(a, b, result, count);
+}
+
+void multiply(const glm::mat4& a, const glm::mat4* b, glm::mat4* result,
+    std::size_t count) noexcept {
+    selected().multiplyBy(a, b, result, count);
+}
+
+void normalMatrices(
+    const glm::mat4* m, glm::mat3* result, std::size_t count) noexcept {
+    selected().normals(m, result, count);
+}
+
+const char* kernels() noexcept {
+    return selected().name;
+}
+
+}  // namespace neat::transform
@@ -0,0 +1,170 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#include <Transform.hh>
+#include <TransformHierarchy.hh>
+
+#include "Parallel.hh"
+
+namespace neat {
+
+uint32_t TransformHierarchy::add(const glm::mat4& local, uint32_t parent) {
+    auto node = static_cast<uint32_t>(slot_.size());
+    auto slot = static_cast<uint32_t>(local_.size());
+    auto parentSlot = parent == none ? none : slot_[parent];
+    auto depth = parentSlot == none ? 0u : depth_[parentSlot] + 1;
+    if (!depth_.empty() && depth < depth_.back()) {
+        sorted_ = false;
+    } else if (depth == levels_.size()) {
+        levels_.push_back(slot);
+    }
+
+    local_.push_back(local);
+    world_.push_back(local);
+    parent_.push_back(parentSlot);
+    depth_.push_back(depth);
+    node_.push_back(node);
+    slot_.push_back(slot);
+    dirty_.push_back(1);
+    changed_.push_back(0);
+    return node;
+}
+
+void TransformHierarchy::sort() {
+    std::vector<uint32_t> order(local_.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(),
+        [this](uint32_t a, uint32_t b) { return depth_[a] < depth_[b]; });
+
+    auto permute = [&order](auto& data) {
+        std::decay_t<decltype(data)> sorted;
+        sorted.reserve(data.size());
+        for (auto slot : order) {
+            sorted.push_back(data[slot]);
+        }
+        data = std::move(sorted);
+    };
+    auto nodes = node_;
+    permute(local_);
+    permute(world_);
+    permute(parent_);
+    permute(depth_);
+    permute(node_);
+    permute(dirty_);
+    permute(changed_);
+
+    levels_.clear();
+    for (uint32_t slot = 0; slot < node_.size(); ++slot) {
+        slot_[node_[slot]] = slot;
+        if (depth_[slot] == levels_.size()) {
+            levels_.push_back(slot);
+        }
+    }
+    for (auto& parent : parent_) {
+        if (parent != none) {
+            parent = slot_[nodes[parent]];
+        }
+    }
+    sorted_ = true;
+}
+
+void TransformHierarchy::setLocal(
+    uint32_t node, const glm::mat4& local) noexcept {
+    local_[slot_[node]] = local;
+    dirty_[slot_[node]] = 1;
+}
+
+const glm::mat4& TransformHierarchy::local(uint32_t node) const noexcept {
+    return local_[slot_[node]];
+}
+
+const glm::mat4& TransformHierarchy::world(uint32_t node) const noexcept {
+    return world_[slot_[node]];
+}
+
+std::size_t TransformHierarchy::size() const noexcept {
+    return node_.size();
+}
+
+std::size_t TransformHierarchy::update() {
+    if (!sorted_) {
+        sort();
+    }
+
+    // a level only depends on the ones above it
+    std::atomic<std::size_t> updated = 0;
+    for (std::size_t level = 0; level < levels_.size(); ++level) {
+        auto first = levels_[level];
+        auto last = level + 1 < levels_.size() ? levels_[level + 1]
+                                               : node_.size();
+        parallelFor(last - first, 4096,
+            [this, first, &updated](std::size_t begin, std::size_t end) {
+                // parents of consecutive changed nodes are gathered, so a
+                // run of them is one call of the batch kernel
+                constexpr std::size_t batch = 64;
+                glm::mat4 parents[batch];
+                std::size_t run = 0;
+                auto flush = [this, &parents, &run](std::size_t next) {
+                    if (run != 0) {
+                        transform::multiply(parents, &local_[next - run],
+                            &world_[next - run], run);
+                        run = 0;
+                    }
+                };
+                std::size_t count = 0;
+                for (auto slot = first + begin; slot < first + end; ++slot) {
+                    auto parent = parent_[slot];
+                    auto changed = dirty_[slot] != 0 ||
+                                   (parent != none && changed_[parent] != 0);
+                    if (changed && parent != none) {
+                        parents[run++] = world_[parent];
+                        if (run == batch) {
+                            flush(slot + 1);
+                        }
+                    } else {
+                        flush(slot);
+                        if (changed) {
+                            world_[slot] = local_[slot];
+                        }
+                    }
+                    changed_[slot] = changed ? 1 : 0;
+                    dirty_[slot] = 0;
+                    count += changed ? 1 : 0;
+                }
+                flush(first + end);
+                updated += count;
+            });
+    }
+    return updated;
+}
+
+bool TransformHierarchy::gather(const std::vector<uint32_t>& nodes,
+    std::vector<glm::mat4>& result) const {
+    result.resize(nodes.size());
+    auto changed = false;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        auto slot = slot_[nodes[i]];
+        result[i] = world_[slot];
+        changed = changed || changed_[slot] != 0;
+    }
+    return changed;
+}
+
+}  // namespace neat
@@ -0,0 +1,260 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NEAT_TRANSFORM_X86
+#endif
+
+namespace neat::transform {
+
+/** One implementation of every batch operation of Transform.hh */
+struct Kernels {
+    const char* name;
+    void (*multiply)(const glm::mat4* a, const glm::mat4* b,
+        glm::mat4* result, std::size_t count);
+    void (*multiplyBy)(const glm::mat4& a, const glm::mat4* b,
+        glm::mat4* result, std::size_t count);
+    void (*normals)(
+        const glm::mat4* m, glm::mat3* result, std::size_t count);
+};
+
+namespace scalar {
+
+inline void multiply(const glm::mat4* a, const glm::mat4* b,
+    glm::mat4* result, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        result[i] = a[i] * b[i];
+    }
+}
+
+inline void multiplyBy(const glm::mat4& a, const glm::mat4* b,
+    glm::mat4* result, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        result[i] = a * b[i];
+    }
+}
+
+/** the inverse transpose of a 3x3 matrix is its cofactor matrix divided
+    by the determinant */
+inline void normals(const glm::mat4* m, glm::mat3* result, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        auto c0 = glm::vec3(m[i][0]);
+        auto c1 = glm::vec3(m[i][1]);
+        auto c2 = glm::vec3(m[i][2]);
+        auto x = glm::cross(c1, c2);
+        auto determinant = glm::dot(c0, x);
+        auto inverse = determinant != 0.f ? 1.f / determinant : 0.f;
+        result[i] = glm::mat3(x * inverse, glm::cross(c2, c0) * inverse,
+            glm::cross(c0, c1) * inverse);
+    }
+}
+
+constexpr Kernels kernels{"scalar", multiply, multiplyBy, normals};
+
+}  // namespace scalar
+
+#ifdef NEAT_TRANSFORM_X86
+
+namespace sse4 {
+
+#define NEAT_SSE4 __attribute__((target("sse4.1")))
+
+/** result column j is the sum of the columns of 'a' scaled by the
+    elements of column j of 'b' */
+NEAT_SSE4 inline void multiply(const __m128* a, const float* b, float* result) {
+    for (auto j = 0; j < 4; ++j) {
+        auto column = _mm_loadu_ps(b + j * 4);
+        auto sum = _mm_mul_ps(a[0], _mm_shuffle_ps(column, column, 0x00));
+        sum = _mm_add_ps(
+            sum, _mm_mul_ps(a[1], _mm_shuffle_ps(column, column, 0x55)));
+        sum = _mm_add_ps(
+            sum, _mm_mul_ps(a[2], _mm_shuffle_ps(column, column, 0xaa)));
+        sum = _mm_add_ps(
+            sum, _mm_mul_ps(a[3], _mm_shuffle_ps(column, column, 0xff)));
+        _mm_storeu_ps(result + j * 4, sum);
+    }
+}
+
+NEAT_SSE4 inline void multiply(const glm::mat4* a, const glm::mat4* b,
+    glm::mat4* result, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto* columns = &a[i][0][0];
+        __m128 left[] = {_mm_loadu_ps(columns), _mm_loadu_ps(columns + 4),
+            _mm_loadu_ps(columns + 8), _mm_loadu_ps(columns + 12)};
+        multiply(left, &b[i][0][0], &result[i][0][0]);
+    }
+}
+
+NEAT_SSE4 inline void multiplyBy(const glm::mat4& a, const glm::mat4* b,
+    glm::mat4* result, std::size_t count) {
+    const auto* columns = &a[0][0];
+    __m128 left[] = {_mm_loadu_ps(columns), _mm_loadu_ps(columns + 4),
+        _mm_loadu_ps(columns + 8), _mm_loadu_ps(columns + 12)};
+    for (std::size_t i = 0; i < count; ++i) {
+        multiply(left, &b[i][0][0], &result[i][0][0]);
+    }
+}
+
+/** a.yzx * b.zxy - a.zxy * b.yzx */
+NEAT_SSE4 inline __m128 cross(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, 0xc9),
+                          _mm_shuffle_ps(b, b, 0xd2)),
+        _mm_mul_ps(_mm_shuffle_ps(a, a, 0xd2), _mm_shuffle_ps(b, b, 0xc9)));
+}
+
+/** the last column is written four floats wide into the next matrix,
+    which is rewritten right after, so the last matrix goes scalar */
+NEAT_SSE4 inline void normals(
+    const glm::mat4* m, glm::mat3* result, std::size_t count) {
+    std::size_t i = 0;
+    for (; i + 1 < count; ++i) {
+        const auto* columns = &m[i][0][0];
+        auto c0 = _mm_loadu_ps(columns);
+        auto c1 = _mm_loadu_ps(columns + 4);
+        auto c2 = _mm_loadu_ps(columns + 8);
+        auto x = cross(c1, c2);
+        auto determinant = _mm_dp_ps(c0, x, 0x7f);
+        auto valid = _mm_cmpneq_ps(determinant, _mm_setzero_ps());
+        auto inverse =
+            _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), determinant));
+        auto* out = &result[i][0][0];
+        _mm_storeu_ps(out, _mm_mul_ps(x, inverse));
+        _mm_storeu_ps(out + 3, _mm_mul_ps(cross(c2, c0), inverse));
+        _mm_storeu_ps(out + 6, _mm_mul_ps(cross(c0, c1), inverse));
+    }
+    scalar::normals(m + i, result + i, count - i);
+}
+
+#undef NEAT_SSE4
+
+constexpr Kernels kernels{"sse4", multiply, multiplyBy, normals};
+
+}  // namespace sse4
+
+namespace avx2 {
+
+#define NEAT_AVX2 __attribute__((target("avx2,fma")))
+
+/** two result columns per register: columns j and j + 1 of 'b' are
+    adjacent, each lane broadcasts its own elements */
+NEAT_AVX2 inline void multiply(const __m256* a, const float* b, float* result) {
+    for (auto j = 0; j < 4; j += 2) {
+        auto columns = _mm256_loadu_ps(b + j * 4);
+        auto sum = _mm256_mul_ps(a[0], _mm256_permute_ps(columns, 0x00));
+        sum = _mm256_fmadd_ps(a[1], _mm256_permute_ps(columns, 0x55), sum);
+        sum = _mm256_fmadd_ps(a[2], _mm256_permute_ps(columns, 0xaa), sum);
+        sum = _mm256_fmadd_ps(a[3], _mm256_permute_ps(columns, 0xff), sum);
+        _mm256_storeu_ps(result + j * 4, sum);
+    }
+}
+
+NEAT_AVX2 inline void multiply(const glm::mat4* a, const glm::mat4* b,
+    glm::mat4* result, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto* columns = &a[i][0][0];
+        __m256 left[] = {
+            _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns)),
+            _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 4)),
+            _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 8)),
+            _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 12))};
+        multiply(left, &b[i][0][0], &result[i][0][0]);
+    }
+}
+
+NEAT_AVX2 inline void multiplyBy(const glm::mat4& a, const glm::mat4* b,
+    glm::mat4* result, std::size_t count) {
+    const auto* columns = &a[0][0];
+    __m256 left[] = {
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 4)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 8)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 12))};
+    for (std::size_t i = 0; i < count; ++i) {
+        multiply(left, &b[i][0][0], &result[i][0][0]);
+    }
+}
+
+NEAT_AVX2 inline __m256 cross(__m256 a, __m256 b) {
+    return _mm256_fmsub_ps(_mm256_permute_ps(a, 0xc9),
+        _mm256_permute_ps(b, 0xd2),
+        _mm256_mul_ps(_mm256_permute_ps(a, 0xd2), _mm256_permute_ps(b, 0xc9)));
+}
+
+NEAT_AVX2 inline __m256 load(const float* low, const float* high) {
+    return _mm256_insertf128_ps(
+        _mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+
+/** two matrices per iteration, one in each half of the registers */
+NEAT_AVX2 inline void normals(
+    const glm::mat4* m, glm::mat3* result, std::size_t count) {
+    std::size_t i = 0;
+    for (; i + 2 < count; i += 2) {
+        const auto* first = &m[i][0][0];
+        const auto* second = &m[i + 1][0][0];
+        auto c0 = load(first, second);
+        auto c1 = load(first + 4, second + 4);
+        auto c2 = load(first + 8, second + 8);
+        auto x = cross(c1, c2);
+        auto determinant = _mm256_dp_ps(c0, x, 0x7f);
+        auto valid =
+            _mm256_cmp_ps(determinant, _mm256_setzero_ps(), _CMP_NEQ_OQ);
+        auto inverse = _mm256_and_ps(
+            valid, _mm256_div_ps(_mm256_set1_ps(1.f), determinant));
+        __m256 columns[] = {_mm256_mul_ps(x, inverse),
+            _mm256_mul_ps(cross(c2, c0), inverse),
+            _mm256_mul_ps(cross(c0, c1), inverse)};
+        for (auto half = 0; half < 2; ++half) {
+            auto* out = &result[i + half][0][0];
+            for (auto c = 0; c < 3; ++c) {
+                _mm_storeu_ps(out + c * 3,
+                    half == 0 ? _mm256_castps256_ps128(columns[c])
+                              : _mm256_extractf128_ps(columns[c], 1));
+            }
+        }
+    }
+    scalar::normals(m + i, result + i, count - i);
+}
+
+#undef NEAT_AVX2
+
+constexpr Kernels kernels{"avx2", multiply, multiplyBy, normals};
+
+}  // namespace avx2
+
+#endif
+
+/** widest kernels the running CPU supports */
+inline const Kernels& select() noexcept {
+#ifdef NEAT_TRANSFORM_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return avx2::kernels;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return sse4::kernels;
+    }
+#endif
+    return scalar::kernels;
+}
+
+}  // namespace neat::transform
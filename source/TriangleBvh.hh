@@ -0,0 +1,200 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.hh"
+
+namespace neat {
+
+/** Static bounding volume hierarchy over the full detail triangles of
+    retained geometry, for exact ray queries */
+class TriangleBvh {
+    struct Node {
+        glm::vec3 min;
+        uint32_t first;  // first triangle of a leaf, else the right child
+        glm::vec3 max;
+        uint32_t count;  // triangles of a leaf, 0 for inner nodes
+    };
+
+    static constexpr unsigned leafSize = 4;
+
+    std::shared_ptr<const Geometry> geometry_;
+    std::vector<uint32_t> triangles_;  // in leaf order
+    std::vector<Node> nodes_;
+
+    [[nodiscard]] glm::vec3 vertex(uint32_t triangle, unsigned k) const
+        noexcept {
+        return geometry_->position(geometry_->indices()[triangle * 3 + k]);
+    }
+
+    [[nodiscard]] glm::vec3 centroid(uint32_t triangle) const noexcept {
+        return (vertex(triangle, 0) + vertex(triangle, 1) +
+                   vertex(triangle, 2)) /
+               3.f;
+    }
+
+    /** splits triangles [first, first + count) at the median of the
+        longest axis of their centroids; the left child follows its
+        parent */
+    void build(std::vector<uint32_t>& order, uint32_t first,
+        uint32_t count) noexcept {
+        auto index = nodes_.size();
+        nodes_.push_back({glm::vec3(std::numeric_limits<float>::max()),
+            first, glm::vec3(-std::numeric_limits<float>::max()), count});
+        auto lower = nodes_[index].min;
+        auto upper = nodes_[index].max;
+        for (auto i = first; i < first + count; ++i) {
+            for (auto k = 0u; k < 3; ++k) {
+                auto v = vertex(order[i], k);
+                nodes_[index].min = glm::min(nodes_[index].min, v);
+                nodes_[index].max = glm::max(nodes_[index].max, v);
+            }
+            lower = glm::min(lower, centroid(order[i]));
+            upper = glm::max(upper, centroid(order[i]));
+        }
+        if (count <= leafSize) {
+            return;
+        }
+
+        auto extent = upper - lower;
+        auto axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                        : (extent.y > extent.z ? 1 : 2);
+        auto middle = order.begin() + first + count / 2;
+        std::nth_element(order.begin() + first, middle,
+            order.begin() + first + count,
+            [this, axis](uint32_t a, uint32_t b) {
+                return centroid(a)[axis] < centroid(b)[axis];
+            });
+        build(order, first, count / 2);
+        nodes_[index].first = static_cast<uint32_t>(nodes_.size());
+        nodes_[index].count = 0;
+        build(order, first + count / 2, count - count / 2);
+    }
+
+    /** Moller-Trumbore, both sides */
+    [[nodiscard]] std::optional<float> intersect(uint32_t triangle,
+        const glm::vec3& origin, const glm::vec3& direction) const noexcept {
+        auto a = vertex(triangle, 0);
+        auto ab = vertex(triangle, 1) - a;
+        auto ac = vertex(triangle, 2) - a;
+        auto p = glm::cross(direction, ac);
+        auto determinant = glm::dot(ab, p);
+        if (std::abs(determinant) < 1e-12f) {
+            return std::nullopt;
+        }
+        auto inverse = 1.f / determinant;
+        auto s = origin - a;
+        auto u = glm::dot(s, p) * inverse;
+        if (u < 0.f || u > 1.f) {
+            return std::nullopt;
+        }
+        auto q = glm::cross(s, ab);
+        auto v = glm::dot(direction, q) * inverse;
+        if (v < 0.f || u + v > 1.f) {
+            return std::nullopt;
+        }
+        auto t = glm::dot(ac, q) * inverse;
+        if (t < 0.f) {
+            return std::nullopt;
+        }
+        return t;
+    }
+
+  public:
+    explicit TriangleBvh(std::shared_ptr<const Geometry> geometry) :
+        geometry_(std::move(geometry)),
+        triangles_(geometry_->indices().size() / 3) {
+        if (triangles_.empty()) {
+            return;
+        }
+        std::iota(triangles_.begin(), triangles_.end(), 0u);
+        nodes_.reserve(2 * triangles_.size() / leafSize + 1);
+        build(triangles_, 0, static_cast<uint32_t>(triangles_.size()));
+    }
+
+    /** distance to the nearest triangle along the ray, in units of
+        'direction' */
+    [[nodiscard]] std::optional<float> intersect(
+        const glm::vec3& origin, const glm::vec3& direction) const noexcept {
+        if (nodes_.empty()) {
+            return std::nullopt;
+        }
+        auto inverse = 1.f / direction;
+        auto limit = std::numeric_limits<float>::max();
+        std::optional<float> nearest;
+
+        auto enter = [&](const Node& node) -> std::optional<float> {
+            auto t0 = (node.min - origin) * inverse;
+            auto t1 = (node.max - origin) * inverse;
+            auto near = glm::min(t0, t1);
+            auto far = glm::max(t0, t1);
+            auto entry = std::max({near.x, near.y, near.z, 0.f});
+            if (entry > std::min({far.x, far.y, far.z, limit})) {
+                return std::nullopt;
+            }
+            return entry;
+        };
+
+        std::vector<std::pair<uint32_t, float>> stack;
+        if (auto entry = enter(nodes_[0])) {
+            stack.emplace_back(0, *entry);
+        }
+        while (!stack.empty()) {
+            auto [index, entry] = stack.back();
+            stack.pop_back();
+            if (entry >= limit) {
+                continue;
+            }
+            const auto& node = nodes_[index];
+            if (node.count != 0) {
+                for (auto i = node.first; i < node.first + node.count; ++i) {
+                    if (auto t = intersect(triangles_[i], origin, direction);
+                        t && *t < limit) {
+                        limit = *t;
+                        nearest = t;
+                    }
+                }
+                continue;
+            }
+
+            uint32_t children[] = {index + 1, node.first};
+            std::optional<float> entries[] = {
+                enter(nodes_[children[0]]), enter(nodes_[children[1]])};
+            auto nearer =
+                entries[1] && (!entries[0] || *entries[1] < *entries[0]) ? 1
+                                                                         : 0;
+            for (auto i : {1 - nearer, nearer}) {
+                if (entries[i]) {
+                    stack.emplace_back(children[i], *entries[i]);
+                }
+            }
+        }
+        return nearest;
+    }
+};
+
+}  // namespace neat
@@ -0,0 +1,161 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <GLES3/gl32.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <Buffer.hh>
+#include <Log.hh>
+#include <NoCopy.hh>
+
+namespace neat {
+
+/** binding points of the std140 uniform blocks the model shaders share */
+enum class BlockBinding : unsigned { Camera, Lights, Material };
+
+constexpr unsigned maxLights = 16;
+
+struct CameraBlock {
+    glm::mat4 view{1.f};
+    glm::mat4 vp{1.f};
+};
+
+struct SunBlock {
+    glm::vec3 color{0.f};
+    float pad0 = 0.f;
+    glm::vec3 direction{0.f};
+    float pad1 = 0.f;
+};
+
+struct PointLightBlock {
+    glm::vec3 color{0.f};
+    float pad = 0.f;
+    glm::vec3 position{0.f};
+    float attenuation = 0.f;
+};
+
+struct LightsBlock {
+    SunBlock sun;
+    std::array<PointLightBlock, maxLights> lights;
+};
+
+/** per draw data, vec3 members padded to vec4 as std140 wants; the
+    quantization of the model rides along with its material */
+struct MaterialBlock {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    glm::vec4 posOffset;
+    glm::vec4 posScale;
+};
+
+static_assert(sizeof(CameraBlock) == 128);
+static_assert(sizeof(SunBlock) == 32 && sizeof(PointLightBlock) == 32);
+static_assert(offsetof(PointLightBlock, attenuation) == 28);
+static_assert(sizeof(LightsBlock) == 32 * (maxLights + 1));
+static_assert(sizeof(MaterialBlock) == 80);
+
+/** distance between blocks of one buffer bound with glBindBufferRange */
+inline std::size_t blockStride(std::size_t size) noexcept {
+    static auto alignment = [] {
+        GLint result = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &result);
+        return static_cast<std::size_t>(result > 0 ? result : 256);
+    }();
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/** Camera and lights blocks, bound once to their binding points; the
+    setters upload only what changed, so the draws themselves set no
+    uniform */
+class SceneBlocks : private NoCopy {
+    Buffer camera_{Buffer::Target::Uniform, true};
+    Buffer lights_{Buffer::Target::Uniform, true};
+    bool sunLit_ = false;
+    std::array<bool, maxLights> lit_{};
+
+    static void upload(const Buffer& buffer, std::size_t offset,
+        const void* data, std::size_t size) noexcept {
+        buffer.bind();
+        buffer.update(offset, data, size);
+    }
+
+  public:
+    SceneBlocks() noexcept {
+        CameraBlock camera;
+        LightsBlock lights;
+        camera_.bind();
+        camera_.set(&camera, sizeof(camera));
+        lights_.bind();
+        lights_.set(&lights, sizeof(lights));
+        camera_.bindBase(Buffer::Target::Uniform,
+            static_cast<unsigned>(BlockBinding::Camera));
+        lights_.bindBase(Buffer::Target::Uniform,
+            static_cast<unsigned>(BlockBinding::Lights));
+    }
+
+    void setCamera(const glm::mat4& view, const glm::mat4& vp) noexcept {
+        CameraBlock camera{view, vp};
+        upload(camera_, 0, &camera, sizeof(camera));
+    }
+
+    void setSun(const glm::vec3& direction, const glm::vec3& color) noexcept {
+        sunLit_ = color != glm::vec3(0.f);
+        SunBlock sun{color, 0.f, direction, 0.f};
+        upload(lights_, offsetof(LightsBlock, sun), &sun, sizeof(sun));
+    }
+
+    void setLight(unsigned index, const glm::vec3& position,
+        const glm::vec3& color, float attenuation) noexcept {
+        if (index >= maxLights) {
+            Log() << "Model: light " << index << " out of range";
+            return;
+        }
+        lit_[index] = color != glm::vec3(0.f);
+        PointLightBlock light{color, 0.f, position, attenuation};
+        upload(lights_,
+            offsetof(LightsBlock, lights) + sizeof(PointLightBlock) * index,
+            &light, sizeof(light));
+    }
+
+    [[nodiscard]] bool sunLit() const noexcept {
+        return sunLit_;
+    }
+
+    /** lights up to the first one without color, the others are unused */
+    [[nodiscard]] unsigned lightCount() const noexcept {
+        auto count = 0u;
+        while (count < maxLights && lit_[count]) {
+            ++count;
+        }
+        return count;
+    }
+};
+
+/** created by the render thread before any shader reads the blocks */
+inline SceneBlocks& sceneBlocks() noexcept {
+    static SceneBlocks blocks;
+    return blocks;
+}
+
+}  // namespace neat
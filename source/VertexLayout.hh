@@ -0,0 +1,187 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+#include <GLES3/gl3.h>
+
+#include <Model.hh>
+
+#include "ModelData.hh"
+#include "Parallel.hh"
+
+namespace neat {
+
+class VertexLayout {
+    struct FloatVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texcoord;
+    };
+
+    struct PackedVertex {
+        uint16_t position[4];
+        uint32_t normal;
+        uint16_t texcoord[2];
+    };
+
+    static_assert(sizeof(FloatVertex) == 32);
+    static_assert(sizeof(PackedVertex) == 16);
+
+    enum { Grain = 4096 };
+
+    VertexFormat format_;
+    glm::vec3 offset_{0.f, 0.f, 0.f};
+    glm::vec3 scale_{1.f, 1.f, 1.f};
+
+    static uint16_t unorm16(float value) noexcept {
+        return static_cast<uint16_t>(
+            std::lround(std::clamp(value, 0.f, 1.f) * 65535.f));
+    }
+
+    static uint32_t snorm10(const glm::vec3& normal) noexcept {
+        return glm::packSnorm3x10_1x2(glm::vec4(normal, 0.f));
+    }
+
+    template <class Vertex, class Encode>
+    std::vector<uint8_t> pack(const ModelData& data, Encode encode) const {
+        auto count = data.vertices.size();
+        std::vector<uint8_t> result(count * sizeof(Vertex));
+        auto* vertices = reinterpret_cast<Vertex*>(result.data());
+        parallelFor(count, Grain, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                auto texcoord = i < data.texcoords.size() ? data.texcoords[i]
+                                                          : glm::vec2(0.f);
+                encode(vertices[i], data.vertices[i], data.normals[i],
+                    texcoord);
+            }
+        });
+        return result;
+    }
+
+  public:
+    explicit VertexLayout(VertexFormat format) noexcept : format_(format) {
+    }
+
+    [[nodiscard]] unsigned stride() const noexcept {
+        return format_ == VertexFormat::Float ? sizeof(FloatVertex)
+                                              : sizeof(PackedVertex);
+    }
+
+    [[nodiscard]] const glm::vec3& offset() const noexcept {
+        return offset_;
+    }
+
+    [[nodiscard]] const glm::vec3& scale() const noexcept {
+        return scale_;
+    }
+
+    std::vector<uint8_t> pack(const ModelData& data) noexcept {
+        switch (format_) {
+            case VertexFormat::Float:
+                return pack<FloatVertex>(data,
+                    [](FloatVertex& v, const glm::vec3& position,
+                        const glm::vec3& normal, const glm::vec2& texcoord) {
+                        v = {position, normal, texcoord};
+                    });
+
+            case VertexFormat::Half:
+                return pack<PackedVertex>(data,
+                    [](PackedVertex& v, const glm::vec3& position,
+                        const glm::vec3& normal, const glm::vec2& texcoord) {
+                        for (auto i = 0; i < 3; ++i) {
+                            v.position[i] = glm::packHalf1x16(position[i]);
+                        }
+                        v.position[3] = glm::packHalf1x16(1.f);
+                        v.normal = snorm10(normal);
+                        v.texcoord[0] = glm::packHalf1x16(texcoord.x);
+                        v.texcoord[1] = glm::packHalf1x16(texcoord.y);
+                    });
+
+            case VertexFormat::Normalized: {
+                if (data.vertices.empty()) {
+                    return {};
+                }
+                auto min = data.vertices[0];
+                auto max = data.vertices[0];
+                for (const auto& v : data.vertices) {
+                    min = glm::min(min, v);
+                    max = glm::max(max, v);
+                }
+                offset_ = min;
+                scale_ = max - min;
+                for (auto i = 0; i < 3; ++i) {
+                    if (scale_[i] == 0.f) {
+                        scale_[i] = 1.f;
+                    }
+                }
+                auto inv = 1.f / scale_;
+                return pack<PackedVertex>(data,
+                    [&min, &inv](PackedVertex& v, const glm::vec3& position,
+                        const glm::vec3& normal, const glm::vec2& texcoord) {
+                        auto p = (position - min) * inv;
+                        for (auto i = 0; i < 3; ++i) {
+                            v.position[i] = unorm16(p[i]);
+                        }
+                        v.position[3] = 0;
+                        v.normal = snorm10(normal);
+                        v.texcoord[0] = glm::packHalf1x16(texcoord.x);
+                        v.texcoord[1] = glm::packHalf1x16(texcoord.y);
+                    });
+            }
+        }
+        return {};
+    }
+
+    void setup(unsigned position, unsigned normal, unsigned texcoord) const
+        noexcept {
+        auto attrib = [this](unsigned index, int size, GLenum type,
+                          bool normalized, std::size_t offset) {
+            glEnableVertexAttribArray(index);
+            glVertexAttribPointer(index, size, type, normalized, stride(),
+                reinterpret_cast<const void*>(offset));
+        };
+
+        if (format_ == VertexFormat::Float) {
+            attrib(position, 3, GL_FLOAT, false,
+                offsetof(FloatVertex, position));
+            attrib(normal, 3, GL_FLOAT, false, offsetof(FloatVertex, normal));
+            attrib(texcoord, 2, GL_FLOAT, false,
+                offsetof(FloatVertex, texcoord));
+            return;
+        }
+
+        if (format_ == VertexFormat::Half) {
+            attrib(position, 3, GL_HALF_FLOAT, false,
+                offsetof(PackedVertex, position));
+        } else {
+            attrib(position, 3, GL_UNSIGNED_SHORT, true,
+                offsetof(PackedVertex, position));
+        }
+        attrib(normal, 4, GL_INT_2_10_10_10_REV, true,
+            offsetof(PackedVertex, normal));
+        attrib(texcoord, 2, GL_HALF_FLOAT, false,
+            offsetof(PackedVertex, texcoord));
+    }
+};
+
+}  // namespace neat
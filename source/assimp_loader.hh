@@ -29,20 +29,17 @@
 
 namespace neat {
 
-inline ModelData loadModel(std::string_view filename) noexcept {
-    Asset asset(filename);
-    std::vector<uint8_t> data;
+/** Parses 'data', the contents of 'filename'; without 'geometry' only the
+    materials are read */
+inline ModelData loadModel(std::string_view filename,
+    const std::vector<uint8_t>& data, bool geometry = true) noexcept {
     ModelData result;
-    if (!asset.valid() || asset.read(data) == Asset::Error) {
-        Log() << "error: cannot open file " << filename;
-        return result;
-    }
-
     static auto importer = Assimp::Importer();
     auto scene = const_cast<aiScene*>(
         importer.ReadFileFromMemory(data.data(), data.size(),
-            aiProcess_GenNormals | aiProcess_FlipUVs |
-                aiProcess_JoinIdenticalVertices));
+            geometry ? aiProcess_GenNormals | aiProcess_FlipUVs |
+                           aiProcess_JoinIdenticalVertices
+                     : 0u));
     if (scene == nullptr || scene->mRootNode == nullptr) {
         Log() << importer.GetErrorString();
         return result;
@@ -94,6 +91,9 @@ inline ModelData loadModel(std::string_view filename) noexcept {
             material.setTexture(std::move(tex.value()));
         }
     }
+    if (!geometry) {
+        return result;
+    }
     auto vertCount = 0u;
     for (auto meshIndex = 0u; meshIndex < scene->mNumMeshes; ++meshIndex) {
         vertCount += scene->mMeshes[meshIndex]->mNumVertices;
@@ -122,17 +122,27 @@ inline ModelData loadModel(std::string_view filename) noexcept {
             }
         }
 
-        std::vector<Mesh::Face> faces;
-        faces.reserve(aimesh->mNumFaces * 3);
-        for (auto i = 0u; i < aimesh->mNumFaces; ++i) {
-            const auto& face = aimesh->mFaces[i];
-            faces.push_back(face.mIndices[0] + offset);
-            faces.push_back(face.mIndices[1] + offset);
-            faces.push_back(face.mIndices[2] + offset);
+        if (aimesh->mNumVertices <= 0x10000) {
+            std::vector<uint16_t> faces;
+            faces.reserve(aimesh->mNumFaces * 3);
+            for (auto i = 0u; i < aimesh->mNumFaces; ++i) {
+                const auto& face = aimesh->mFaces[i];
+                faces.push_back(face.mIndices[0]);
+                faces.push_back(face.mIndices[1]);
+                faces.push_back(face.mIndices[2]);
+            }
+            result.meshes.push_back(
+                {std::move(faces), offset, aimesh->mMaterialIndex, {}, {}, {}});
+        } else {
+            std::vector<uint32_t> faces;
+            faces.reserve(aimesh->mNumFaces * 3);
+            for (auto i = 0u; i < aimesh->mNumFaces; ++i) {
+                const auto& face = aimesh->mFaces[i];
+                faces.insert(faces.end(), face.mIndices, face.mIndices + 3);
+            }
+            MeshData::append(result.meshes, faces.data(), faces.size(), offset,
+                aimesh->mMaterialIndex);
         }
-
-        result.meshes.emplace_back(
-            faces.data(), faces.size(), aimesh->mMaterialIndex);
         offset += aimesh->mNumVertices;
     }
 
@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 
 #include <Asset.hh>
@@ -72,7 +74,9 @@ enum class Chunk : uint16_t {
     Hierarchy = 0xb030
 };
 
-class M3dStream : public Asset {
+class M3dStream {
+    const std::vector<uint8_t>& data_;
+    std::size_t offset_ = 0;
     uint32_t mainLength_ = 0;
 
   public:
@@ -83,14 +87,32 @@ class M3dStream : public Asset {
     };
 #pragma pack(pop)
 
-    explicit M3dStream(std::string_view filename) noexcept : Asset(filename) {
+    enum : uint64_t { Error = Asset::Error };
+
+    explicit M3dStream(const std::vector<uint8_t>& data) noexcept :
+        data_(data) {
         Header header;  // NOLINT(hicpp-member-init)
-        if (Asset::valid() && read(&header, sizeof(Header)) != Error &&
+        if (read(&header, sizeof(Header)) != Error &&
             static_cast<Chunk>(header.id) == m3d::Chunk::Main) {
             mainLength_ = header.len;
         }
     }
 
+    uint64_t read(void* data, uint64_t size) {
+        if (size > data_.size() - offset_) {
+            offset_ = data_.size();
+            return Error;
+        }
+        std::memcpy(data, data_.data() + offset_, size);
+        offset_ += size;
+        return size;
+    }
+
+    uint64_t seek(uint64_t ofs) {
+        offset_ += std::min<uint64_t>(ofs, data_.size() - offset_);
+        return offset_;
+    }
+
     uint32_t length() const {
         return mainLength_;
     }
@@ -185,13 +207,16 @@ class M3dStream : public Asset {
 
 namespace neat {
 
-inline ModelData loadModel(std::string_view filename) noexcept {
+/** Parses 'data', the contents of 'filename'; without 'geometry' only the
+    materials are read */
+inline ModelData loadModel(std::string_view filename,
+    const std::vector<uint8_t>& data, bool geometry = true) noexcept {
     auto parentPath = std::filesystem::path(filename).parent_path();
-    m3d::M3dStream source(filename);
+    m3d::M3dStream source(data);
     ModelData result;
 
     if (source.length() == 0) {
-        Log() << "error: cannot open file " << filename;
+        Log() << "error: cannot parse file " << filename;
         return result;
     }
     auto handleMaterialBlock = [&source, &parentPath, &result](uint32_t len) {
@@ -233,6 +258,9 @@ inline ModelData loadModel(std::string_view filename) noexcept {
     };
 
     auto handleMeshBlock = [&](uint32_t len) {
+        if (!geometry) {
+            return false;
+        }
         std::vector<std::vector<uint16_t>> materialFaces;
         std::vector<glm::vec<3, uint16_t>> faceDescriptos;
         auto handleFaces = [&source, &materialFaces](
@@ -301,23 +329,19 @@ inline ModelData loadModel(std::string_view filename) noexcept {
         });
 
         if (!result.vertices.empty() && !faceDescriptos.empty()) {
-            std::vector<Mesh::Face> faces;
             size_t face = 0;
             for (size_t meshIndex = 0; meshIndex != materialFaces.size();
                  ++meshIndex) {
+                std::vector<uint16_t> faces;
                 faces.reserve(materialFaces[meshIndex].size() * 3);
                 for (auto end = materialFaces[meshIndex].size() + face;
                      face < end; ++face) {
-                    faces.push_back(
-                        static_cast<Mesh::Face>(faceDescriptos[face].x));
-                    faces.push_back(
-                        static_cast<Mesh::Face>(faceDescriptos[face].y));
-                    faces.push_back(
-                        static_cast<Mesh::Face>(faceDescriptos[face].z));
+                    faces.push_back(faceDescriptos[face].x);
+                    faces.push_back(faceDescriptos[face].y);
+                    faces.push_back(faceDescriptos[face].z);
                 }
-                result.meshes.emplace_back(
-                    faces.data(), faces.size(), meshIndex);
-                faces.clear();
+                result.meshes.push_back({std::move(faces), 0,
+                    static_cast<unsigned>(meshIndex), {}, {}, {}});
             }
             result.normals.resize(result.vertices.size(), glm::vec3(0, 0, 0));
             for (const auto& face : faceDescriptos) {
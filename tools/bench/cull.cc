@@ -0,0 +1,96 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bounds.hh"
+#include "Culling.hh"
+
+namespace {
+
+constexpr std::size_t Instances = 100000;
+constexpr int Passes = 200;
+
+template <class Func>
+double measure(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < Passes; ++pass) {
+        func();
+    }
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / Passes;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-500.f, 500.f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.f);
+
+    std::vector<glm::mat4> instances(Instances);
+    neat::Spheres spheres;
+    spheres.resize(Instances);
+    for (std::size_t i = 0; i < Instances; ++i) {
+        auto x = position(random);
+        auto y = position(random);
+        auto z = position(random);
+        auto& m = instances[i];
+        m = glm::mat4(scale(random));
+        m[3] = glm::vec4(x, y, z, 1.f);
+        spheres.set(i, neat::transformSphere(glm::vec4(0.f, 0.f, 0.f, 1.f), m));
+    }
+
+    auto vp = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 1000.f) *
+              glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f),
+                  glm::vec3(0.f, 1.f, 0.f));
+    auto frustum = neat::Frustum::fromMatrix(vp);
+
+    std::vector<uint32_t> visible(Instances);
+    std::vector<glm::mat4> compacted(Instances);
+    auto run = [&](const char* name, neat::culling::Kernel kernel) {
+        std::size_t count = 0;
+        auto cull = measure([&] {
+            count = kernel(frustum, spheres, 0, Instances, visible.data());
+        });
+        auto compact = measure([&] {
+            count = kernel(frustum, spheres, 0, Instances, visible.data());
+            for (std::size_t i = 0; i < count; ++i) {
+                compacted[i] = instances[visible[i]];
+            }
+        });
+        std::printf("%-7s %zu instances, %zu visible: cull %.1f us, "
+                    "cull and compact %.1f us\n",
+            name, Instances, count, cull, compact);
+    };
+
+    run("scalar", neat::culling::scalar);
+#ifdef NEAT_CULL_X86
+    if (__builtin_cpu_supports("sse2")) {
+        run("sse", neat::culling::sse);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        run("avx2", neat::culling::avx2);
+    }
+#endif
+    return 0;
+}
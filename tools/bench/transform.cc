@@ -0,0 +1,123 @@
+/*
+    neat - simple graphics engine
+    This library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "TransformKernels.hh"
+
+namespace {
+
+constexpr std::size_t Instances = 100000;
+constexpr int Passes = 200;
+
+template <class Func>
+double measure(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < Passes; ++pass) {
+        func();
+    }
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / Passes;
+}
+
+template <class Matrix>
+float difference(const Matrix& a, const Matrix& b) {
+    auto result = 0.f;
+    for (auto c = 0; c < Matrix::length(); ++c) {
+        result = std::max(result, glm::length(a[c] - b[c]));
+    }
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-500.f, 500.f);
+    std::uniform_real_distribution<float> angle(0.f, 6.28f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.f);
+
+    std::vector<glm::mat4> parents(Instances);
+    std::vector<glm::mat4> locals(Instances);
+    for (std::size_t i = 0; i < Instances; ++i) {
+        for (auto* m : {&parents[i], &locals[i]}) {
+            *m = glm::translate(glm::mat4(1.f),
+                glm::vec3(position(random), position(random),
+                    position(random)));
+            *m = glm::rotate(*m, angle(random), glm::vec3(0.f, 1.f, 0.f));
+            *m = glm::scale(*m, glm::vec3(scale(random)));
+        }
+    }
+    auto view = glm::lookAt(glm::vec3(10.f, 20.f, 30.f), glm::vec3(0.f),
+        glm::vec3(0.f, 1.f, 0.f));
+
+    std::vector<glm::mat4> reference(Instances);
+    std::vector<glm::mat4> referenceBy(Instances);
+    std::vector<glm::mat3> referenceNormals(Instances);
+    std::vector<glm::mat4> worlds(Instances);
+    std::vector<glm::mat3> normals(Instances);
+    neat::transform::scalar::multiply(
+        parents.data(), locals.data(), reference.data(), Instances);
+    neat::transform::scalar::multiplyBy(
+        view, locals.data(), referenceBy.data(), Instances);
+    neat::transform::scalar::normals(
+        locals.data(), referenceNormals.data(), Instances);
+
+    auto run = [&](const neat::transform::Kernels& kernels) {
+        auto error = 0.f;
+        auto multiply = measure([&] {
+            kernels.multiply(
+                parents.data(), locals.data(), worlds.data(), Instances);
+        });
+        for (std::size_t i = 0; i < Instances; ++i) {
+            error = std::max(error, difference(worlds[i], reference[i]));
+        }
+        auto multiplyBy = measure([&] {
+            kernels.multiplyBy(view, locals.data(), worlds.data(), Instances);
+        });
+        for (std::size_t i = 0; i < Instances; ++i) {
+            error = std::max(error, difference(worlds[i], referenceBy[i]));
+        }
+        auto normal = measure([&] {
+            kernels.normals(locals.data(), normals.data(), Instances);
+        });
+        for (std::size_t i = 0; i < Instances; ++i) {
+            error = std::max(
+                error, difference(normals[i], referenceNormals[i]));
+        }
+        std::printf("%-7s %zu matrices: model x parent %.1f us, "
+                    "view x model %.1f us, normal matrices %.1f us, "
+                    "max error %g\n",
+            kernels.name, Instances, multiply, multiplyBy, normal, error);
+    };
+
+    run(neat::transform::scalar::kernels);
+#ifdef NEAT_TRANSFORM_X86
+    if (__builtin_cpu_supports("sse4.1")) {
+        run(neat::transform::sse4::kernels);
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        run(neat::transform::avx2::kernels);
+    }
+#endif
+    return 0;
+}
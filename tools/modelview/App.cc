@@ -20,73 +20,177 @@
 
 #include "App.hh"
 
+enum { UpdateRate = 8 };
+
+static neat::ModelOptions pickable() {
+    neat::ModelOptions options;
+    options.pickable = true;
+    return options;
+}
+
 App::App(int width, int height, const char* filename) :
-    model_(filename),
+    model_(filename, pickable()),
+    modelId_(-1),
+    projection_(glm::perspective(glm::radians(90.0f),
+        static_cast<float>(width) / height, 0.1f, 4000.0f)),
+    size_(width, height),
     far_(60.f),
     pos_(glm::rotate(glm::mat4(1.f), 70.f, {-1, 0, 0})),
-    projection_(glm::perspective(glm::radians(90.0f),
-        static_cast<float>(width) / height, 0.1f, 4000.0f)) {
+    movePos_(pos_),
+    lastUpdate_(0),
+    appliedPos_(pos_),
+    pipeline_([this](uint64_t time, Frame& frame) { simulate(time, frame); },
+        [this](const Frame& frame) { apply(frame); },
+        [this](const Frame& frame) { record(frame); },
+        [this](const Frame& frame) { render(frame); }) {
     if (!model_.valid()) {
         throw std::runtime_error("cannot load model!!!");
     }
 
     neat::Model::setLight(0, {-1.f, 1.f, 2.f}, {0.8f, 0.4f, 0.8f}, 0.f);
     model_.setPos(pos_);
+    modelId_ = index_.insert(model_.bounds(), 0);
     updateView(far_);
+    appliedView_ = view_;
+    neat::Model::setVP(view_, projection_);
+
+    // the first frame then draws without compiling anything
+    neat::Model::finishShaders();
+    auto& state = neat::GLState::instance();
+    state.enable(GL_DEPTH_TEST, true);
+    state.enable(GL_CULL_FACE, true);
+    model_.render(queue_.list());
+    queue_.prewarm();
+    state.enable(GL_CULL_FACE, false);
+    state.enable(GL_DEPTH_TEST, false);
 }
 
 void App::updateView(float farDiff) {
     far_ += farDiff;
-    glm::mat4 view = glm::lookAt(
+    view_ = glm::lookAt(
         glm::vec3(0.f, 0.0f, far_), glm::vec3(0, 40.f, 0), glm::vec3(0, 1, 0));
-    neat::Model::setVP(view, projection_);
 }
 
-int App::action(neat::Actions action, int x, int y) {  // NOLINT
-    static std::optional<std::pair<int, int>> pressed = std::nullopt;
-    static glm::mat4 movePos = pos_;
-    static constexpr auto speed = 100.f;
+bool App::pick(int x, int y) const {
+    auto ndc = glm::vec2(x, size_.y - y) / size_ * 2.f - 1.f;
+    auto unproject = glm::inverse(projection_ * view_);
+    auto near = unproject * glm::vec4(ndc.x, ndc.y, -1.f, 1.f);
+    auto far = unproject * glm::vec4(ndc.x, ndc.y, 1.f, 1.f);
+    auto origin = glm::vec3(near) / near.w;
+    auto direction = glm::vec3(far) / far.w - origin;
+    return index_
+        .raycast(origin, direction,
+            [this, &origin, &direction](uint32_t) {
+                return model_.intersect(origin, direction);
+            })
+        .has_value();
+}
+
+int App::action(neat::Actions action, int x, int y) {
+    if (action == neat::Actions::Back) {
+        return 1;
+    }
+    // the simulation of the next frame may be running, leave it the input
+    std::lock_guard lock(inputMutex_);
+    inputs_.push_back({action, x, y});
+    return 0;
+}
 
-    switch (action) {
-        case neat::Actions::Back:
-            return 1;
+void App::handle(const Input& input) {
+    static constexpr auto speed = 100.f;
 
+    switch (input.action) {
         case neat::Actions::TouchDown:
-            pressed = std::make_pair(x, y);
+            // only a touch on the model itself rotates it
+            if (pick(input.x, input.y)) {
+                pressed_ = std::make_pair(input.x, input.y);
+            }
             break;
 
         case neat::Actions::TouchUp:
-            pressed = std::nullopt;
-            pos_ = movePos;
+            if (pressed_) {
+                pressed_ = std::nullopt;
+                pos_ = movePos_;
+            }
             break;
 
         case neat::Actions::Move:
-            if (pressed) {
-                movePos = glm::rotate(pos_,
-                    static_cast<float>(x - pressed->first) / speed, {0, 0, 1});
-                movePos = glm::rotate(movePos,
-                    static_cast<float>(y - pressed->second) / speed, {1, 0, 0});
-                model_.setPos(movePos);
+            if (pressed_) {
+                movePos_ = glm::rotate(pos_,
+                    static_cast<float>(input.x - pressed_->first) / speed,
+                    {0, 0, 1});
+                movePos_ = glm::rotate(movePos_,
+                    static_cast<float>(input.y - pressed_->second) / speed,
+                    {1, 0, 0});
             }
             break;
 
         case neat::Actions::Zoom:
-            updateView(-y);
+            updateView(-input.y);
             break;
 
         default:
             break;
     }
-    return 0;
 }
 
-void App::draw() {
+/** runs on a worker while the previous frame renders: no GL calls, and the
+    model is only read, its instances change in apply() */
+void App::simulate(uint64_t time, Frame& frame) {
+    {
+        std::lock_guard lock(inputMutex_);
+        processing_.swap(inputs_);
+    }
+    for (const auto& input : processing_) {
+        handle(input);
+    }
+    processing_.clear();
+
+    if (lastUpdate_ == 0) {
+        lastUpdate_ = time;
+    }
+    auto count = (time - lastUpdate_) / UpdateRate;
+    if (count > 0) {
+        lastUpdate_ = time;
+        update(count);
+    }
+
+    frame.pos = movePos_;
+    frame.view = view_;
+}
+
+void App::apply(const Frame& frame) {
+    if (frame.pos != appliedPos_) {
+        appliedPos_ = frame.pos;
+        model_.setPos(frame.pos);
+        index_.update(modelId_, model_.bounds());
+    }
+    if (frame.view != appliedView_) {
+        appliedView_ = frame.view;
+        neat::Model::setVP(frame.view, projection_);
+    } else {
+        // lights may change without the camera moving
+        neat::Model::pollShaders();
+    }
+}
+
+/** culling, LOD selection and occlusion, on a worker after apply() */
+void App::record(const Frame&) {
+    model_.render(queue_.list());
+}
+
+void App::render(const Frame&) {
     glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    model_.render();
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
+    auto& state = neat::GLState::instance();
+    state.enable(GL_DEPTH_TEST, true);
+    state.enable(GL_CULL_FACE, true);
+    queue_.submit();
+    state.enable(GL_CULL_FACE, false);
+    state.enable(GL_DEPTH_TEST, false);
+}
+
+void App::draw(uint64_t time) {
+    pipeline_.frame(time);
 }
 
 void App::update(unsigned iters) {
@@ -17,25 +17,74 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
+#include <FramePipeline.hh>
+#include <GLState.hh>
 #include <NoCopy.hh>
 #include <Actions.hh>
 #include <Model.hh>
+#include <RenderQueue.hh>
+#include <SpatialIndex.hh>
 
 #include <glm/mat4x4.hpp>
 
 class App : private neat::NoCopy {
+    /** what rendering a frame needs from its simulation */
+    struct Frame {
+        glm::mat4 pos;
+        glm::mat4 view;
+    };
+
+    struct Input {
+        neat::Actions action;
+        int x;
+        int y;
+    };
+
     neat::Model model_;
+    neat::RenderQueue queue_;
+    neat::SpatialIndex index_;
+    int modelId_;
+    glm::mat4 projection_;
+    glm::vec2 size_;
+
+    // input queued by action() for the next simulation
+    std::mutex inputMutex_;
+    std::vector<Input> inputs_;
+
+    // simulation state, only touched by simulate()
+    std::optional<std::pair<int, int>> pressed_;
     float far_;
     glm::mat4 pos_;
-    glm::mat4 projection_;
+    glm::mat4 movePos_;
+    glm::mat4 view_;
+    uint64_t lastUpdate_;
+    std::vector<Input> processing_;
+
+    // state of the frame last applied to the model
+    glm::mat4 appliedPos_;
+    glm::mat4 appliedView_;
+
+    neat::FramePipeline<Frame> pipeline_;
+
+    void simulate(uint64_t time, Frame& frame);
+    void apply(const Frame& frame);
+    void record(const Frame& frame);
+    void render(const Frame& frame);
+    void handle(const Input& input);
     void updateView(float farDiff);
+    bool pick(int x, int y) const;
 
   public:
     App(int width, int height, const char* filename);
     ~App() = default;
     int action(neat::Actions act, int x, int y);
-    void draw();
+    void draw(uint64_t time);
     void update(unsigned iters);
 };
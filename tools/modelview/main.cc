@@ -45,15 +45,11 @@ void queryData(NeatWindowData* data) {
     neat::Log::tag = data->caption;
 }
 
-enum { UpdateRate = 8 };
-
 void draw(uint64_t time) {
-    static uint64_t lasthit = time;
-    size_t count = (time - lasthit) / UpdateRate;
+    _app->draw(time);
+}
 
-    if (count > 0) {
-        lasthit = time;
-        _app->update(count);
-    }
-    _app->draw();
+void deinit() {
+    // before the job system the frame pipeline waits on is destroyed
+    _app.reset();
 }
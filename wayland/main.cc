@@ -282,6 +282,10 @@ class WaylandWindow : private NoCopy {
 
 std::unique_ptr<WaylandWindow> wnd;
 
+// applications without anything to release keep linking
+__attribute__((weak)) void deinit() {
+}
+
 void sigHandler([[maybe_unused]] int sig) {
     wnd->stop();
 }
@@ -289,5 +293,7 @@ void sigHandler([[maybe_unused]] int sig) {
 int main(int argc, char** argv) {
     signal(SIGINT, sigHandler);
     wnd = std::make_unique<WaylandWindow>(argc, argv);
-    return wnd->loop();
+    auto result = wnd->loop();
+    deinit();
+    return result;
 }
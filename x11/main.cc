@@ -142,6 +142,10 @@ class X11Window : private NoCopy {
 
 std::unique_ptr<X11Window> wnd;
 
+// applications without anything to release keep linking
+__attribute__((weak)) void deinit() {
+}
+
 void sigHandler([[maybe_unused]] int sig) {
     wnd->stop();
 }
@@ -149,5 +153,7 @@ void sigHandler([[maybe_unused]] int sig) {
 int main(int argc, char* argv[]) {
     signal(SIGINT, sigHandler);
     wnd = std::make_unique<X11Window>(argc, argv);
-    return wnd->loop();
+    auto result = wnd->loop();
+    deinit();
+    return result;
 }